@@ -1,9 +1,38 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+// Build with PARKING_THREADS=0 on toolchains without pthreads
+#ifndef PARKING_THREADS
+#define PARKING_THREADS 1
+#endif
+#if PARKING_THREADS
+#include <pthread.h>
+#include <errno.h>
+#endif
+
+// Build with FIXED_LOT=1 for a gate controller running one lot of MAX_PARKING_SPACES spaces.
+// The layout, tier ranges and tariff then come from constant tables, spaces are found
+// with a bitmap scan and fees with a table lookup (see find_space_in_lot).
+#ifndef FIXED_LOT
+#define FIXED_LOT 0
+#endif
+
+// Build with PARKING_BENCH=1 to time the gate path (see run_gate_benchmark) instead of
+// starting the console; the figures in the README come from this
+#ifndef PARKING_BENCH
+#define PARKING_BENCH 0
+#endif
 
 // Constants
 #define MAX_PARKING_SPACES 50
+#define GOLD_LAST_SPACE 10
+#define PREMIUM_LAST_SPACE 20
 #define FREE 0
 #define OCCUPIED 1
 #define GOLDEN_HOURS 200
@@ -12,8 +41,51 @@
 #define PREMIUM 1
 #define NONE 0
 #define BASE_FEES 100
+#define BASE_HOURS 3
 #define EXTRA_FEES 50
 #define DISCOUNT 0.10
+#define WORKER_THREADS 4
+#define RETIER_CHUNK_SIZE 4096
+#define PARALLEL_SORT_MIN 65536
+#define REPORT_PAGE_SIZE 20
+#define REPORT_BUFFER_SIZE (1 << 20)
+#define REPORT_TEXT 0
+#define REPORT_CSV 1
+#define REPORT_BINARY 2
+#define PLATE_MAX_LENGTH 12
+#define PLATE_RADIX 37
+#define VEHICLE_NUM_SIZE (PLATE_MAX_LENGTH + 1)
+#define OWNER_NAME_SIZE 20
+#define NAME_TABLE_INITIAL_SIZE 1024
+#define PLATE_MATCH_DISTANCE 1
+#define PLATE_SEARCH_DISTANCE 2
+#define MAX_PLATE_MATCHES 20
+#define TRIE_BLOCK_SIZE 4096
+#define VEHICLE_BLOCK_SIZE 4096
+#define NAME_BLOCK_SIZE 65536
+#define ARRIVAL 0
+#define DEPARTURE 1
+#define SIM_ARRIVALS_CONSTANT 1
+#define SIM_ARRIVALS_HOURLY 2
+#define SIM_MAX_DAYS 50000
+#define SIM_MAX_ARRIVALS_PER_HOUR 100000
+#define SIM_MAX_ARRIVALS 100000000LL
+#define SIM_MAX_STAY_HOURS 8760
+#define SIM_MAX_FEE 100000
+#define SIM_MAX_EXTRA_FEE 1000
+#define STORE_BATCH_RECORDS 4096
+#define CHECKPOINT_SECONDS 5
+#define IMPORT_BUFFER_SIZE (1 << 20)
+#define MAX_LINE_FIELDS 8
+#define MAX_RESIDENT_VEHICLES 100000
+#define RESIDENT_WINDOW_DAYS 30
+#define INDEX_PAGE_ENTRIES 256
+#define FIXED_FEE_HOURS 64
+#define BENCH_ROUNDS 5000000
+
+#if FIXED_LOT && MAX_PARKING_SPACES > 64
+#error "FIXED_LOT keeps the free spaces in a 64-bit mask, MAX_PARKING_SPACES must be at most 64"
+#endif
 
 // Structure for arrival and departure times
 struct datetime {
@@ -23,67 +95,410 @@ struct datetime {
     int year;
 };
 
-// Structure for vehicle node in linked list
+// Structure for vehicle node in linked list.
+// The vehicle number is packed base-37 (see encode_plate), arrival is in minutes
+// since 1990 (see datetime_to_minutes) and the owner name points into the
+// interned name table, or with FIXED_LOT is held in the node so registering a vehicle
+// does not allocate (see set_owner_name). Hot fields come first; owner_name is only read for output.
+// slot is the record number in vehicles.dat (-1 until first saved), dirty marks unsaved changes
+// and referenced is the CLOCK bit set on every lookup (see evict_cold_vehicles).
 typedef struct vehicle_node {
-    char vehicle_num[10];
-    char owner_name[20];
-    struct datetime arrival;
-    struct datetime departure;
-    int membership;
+    uint64_t plate;
+    struct vehicle_node* next;
+    uint32_t arrival;
     int total_parking_hours;
-    int parking_ID;
     int total_amount_paid;
     int parking_count;
-    struct vehicle_node* next;
+    unsigned char membership;
+    unsigned char dirty : 1;
+    unsigned char referenced : 1;
+    unsigned short parking_ID;
+    int slot;
+#if FIXED_LOT
+    char owner_name[OWNER_NAME_SIZE];
+#else
+    const char* owner_name;
+#endif
 } vehicle;
 
+// Vehicle nodes are carved out of blocks like trie nodes, one malloc per vehicle was the
+// main cost of an import. Nodes dropped by eviction go on spare_vehicles and are reused.
+struct vehicle_block {
+    struct vehicle_block* next;
+    int used;
+    struct vehicle_node nodes[VEHICLE_BLOCK_SIZE];
+};
+struct vehicle_block* vehicle_blocks = NULL;
+struct vehicle_node* spare_vehicles = NULL;
+
+#if FIXED_LOT
+// A gate controller takes its resident vehicles from a static pool first; blocks are only
+// allocated if more vehicles than MAX_RESIDENT_VEHICLES must stay in memory at once
+// (unsaved or parked ones, or a text import).
+struct vehicle_node fixed_vehicle_pool[MAX_RESIDENT_VEHICLES];
+int fixed_vehicles_used = 0;
+#endif
+
 // Structure for parking space node in linked list
 struct parking_node {
     int parking_space_ID;
     int status;
     int occupancy_count;
     int space_revenue;
+    int dirty;
+    uint64_t occupant;
     struct parking_node* next;
 };
 
+// Structure for a lot's layout and tariff: which spaces each membership may take and
+// what a stay costs. The gates use gate_policy; the simulator can sweep other values.
+struct lot_policy {
+    int gold_last_space;
+    int premium_last_space;
+    int base_fee;
+    int base_hours;
+    int extra_fee;
+    double discount;
+};
+
+const struct lot_policy gate_policy = {
+    GOLD_LAST_SPACE, PREMIUM_LAST_SPACE, BASE_FEES, BASE_HOURS, EXTRA_FEES, DISCOUNT
+};
+
 // Global pointers for the linked lists
 struct vehicle_node* vehicle_list = NULL;
 struct parking_node* parking_list = NULL;
 int vehicle_count = 0;
 
+#if FIXED_LOT
+// The fixed lot: space ID lives at fixed_spaces[ID - 1], and bit ID - 1 of
+// free_space_mask is set while it is free. parking_list points at fixed_spaces.
+struct parking_node fixed_spaces[MAX_PARKING_SPACES];
+uint64_t free_space_mask = 0;
+
+// Bits for spaces first to last, counting from 1
+#define SPACE_BITS(first, last) ((~0ULL >> (64 - (last))) & ~((1ULL << ((first) - 1)) - 1))
+
+// Spaces each membership may take, indexed by NONE, PREMIUM and GOLD
+const uint64_t tier_space_mask[3] = {
+    SPACE_BITS(PREMIUM_LAST_SPACE + 1, MAX_PARKING_SPACES),
+    SPACE_BITS(GOLD_LAST_SPACE + 1, PREMIUM_LAST_SPACE),
+    SPACE_BITS(1, GOLD_LAST_SPACE),
+};
+
+// Tariff for stays of 0 to FIXED_FEE_HOURS - 1 hours, row 0 without membership and
+// row 1 with, expanded by the compiler from the gate_policy tariff calculate_parking_fee uses
+#define FEE_FOR(hours) (BASE_FEES + ((hours) > BASE_HOURS ? ((hours) - BASE_HOURS) * EXTRA_FEES : 0))
+#define MEMBER_FEE_FOR(hours) ((int)(FEE_FOR(hours) * (1.0 - DISCOUNT)))
+#define FEES_4(fee, hours) fee(hours), fee(hours + 1), fee(hours + 2), fee(hours + 3)
+#define FEES_16(fee, hours) FEES_4(fee, hours), FEES_4(fee, hours + 4), FEES_4(fee, hours + 8), FEES_4(fee, hours + 12)
+#define FEES_64(fee, hours) FEES_16(fee, hours), FEES_16(fee, hours + 16), FEES_16(fee, hours + 32), FEES_16(fee, hours + 48)
+const int fee_table[2][FIXED_FEE_HOURS] = {
+    { FEES_64(FEE_FOR, 0) },
+    { FEES_64(MEMBER_FEE_FOR, 0) },
+};
+#endif
+
+// Only recent and parked vehicles are kept in vehicle_list; the rest stay in vehicles.dat
+// and are read back on first lookup through vehicles.idx. vehicle_count counts every registered
+// vehicle, resident_count the ones in memory. resident_slots has one bit per store slot in memory.
+// A parking space keeps the plate of the vehicle in it as occupant (0 if none known), in memory only.
+int resident_count = 0;
+unsigned char* resident_slots = NULL;
+int resident_slots_size = 0;
+struct vehicle_node** clock_hand = &vehicle_list;
+
+// Every gate write takes registry_lock and bumps registry_version. Reports never
+// read the live lists; they work on a registry_snapshot (see acquire_snapshot).
+#if PARKING_THREADS
+pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t exports_done = PTHREAD_COND_INITIALIZER;
+pthread_cond_t cold_scans_done = PTHREAD_COND_INITIALIZER;
+pthread_cond_t checkpoint_wakeup = PTHREAD_COND_INITIALIZER;
+pthread_t checkpoint_thread;
+#endif
+unsigned long registry_version = 0;
+int exports_running = 0;
+int checkpoint_timer_running = 0;
+
+// Structure for a snapshot reading the cold records of vehicles.dat without registry_lock.
+// It covers the slots below slot_count that were not resident when the snapshot was taken;
+// while it is registered in active_cold_scans those records are not rewritten.
+struct cold_scan {
+    int slot_count;
+    unsigned char* resident;
+    int resident_size;
+    struct cold_scan* next;
+};
+struct cold_scan* active_cold_scans = NULL;
+
+// Structure for a point-in-time copy of the registry shared by readers.
+// Resident vehicles and spaces are copied into two arrays and linked in list order; they are
+// never changed after capture. Vehicles only in vehicles.dat are not copied: scan records
+// which slots held them, and select_vehicle_rows streams those records from the store.
+// The scan stays in active_cold_scans until the last reader releases the snapshot.
+struct registry_snapshot {
+    unsigned long version;
+    int refcount;
+    int vehicle_count;
+    int resident_count;
+    struct vehicle_node* vehicles;
+    struct parking_node* spaces;
+    struct cold_scan scan;
+};
+
+// Latest snapshot, holds one reference of its own until a newer one replaces it.
+// Only a snapshot with every vehicle in memory is kept here, one with a cold scan is
+// freed as soon as its last reader is done.
+struct registry_snapshot* current_snapshot = NULL;
+
+// Structure for a node of the vehicle number trie. Children hang off child as a
+// sibling list sorted by digit, so every search returns plates in sorted order.
+// The trie holds the resident vehicles and the stored ones that vehicles.idx does not cover yet:
+// a terminal node points at its vehicle, or keeps the store slot of one that is not in memory.
+struct trie_node {
+    unsigned char digit;
+    unsigned char terminal;
+    int slot;
+    struct vehicle_node* vehicle;
+    struct trie_node* child;
+    struct trie_node* sibling;
+};
+
+// Trie nodes are carved out of blocks, a registry of millions of plates needs tens of millions of nodes
+struct trie_block {
+    struct trie_block* next;
+    int used;
+    struct trie_node nodes[TRIE_BLOCK_SIZE];
+};
+
+// Plate search index for resident vehicles and stored ones vehicles.idx does not cover yet.
+// Nodes pruned when a vehicle is evicted go on spare_trie_nodes, linked through child.
+struct trie_node* plate_trie = NULL;
+struct trie_block* trie_blocks = NULL;
+struct trie_node* spare_trie_nodes = NULL;
+
+#if FIXED_LOT
+// Enough trie nodes for MAX_RESIDENT_VEHICLES plates of full length, used before any block
+struct trie_node fixed_trie_pool[MAX_RESIDENT_VEHICLES * PLATE_MAX_LENGTH];
+int fixed_trie_nodes_used = 0;
+#endif
+
+// Structure for a plate and its vehicle or store slot while the index is built
+struct indexed_plate {
+    uint64_t plate;
+    int slot;
+    struct vehicle_node* vehicle;
+};
+
+// Structure for a list of plates returned by a search
+struct plate_matches {
+    uint64_t plates[MAX_PLATE_MATCHES];
+    int distances[MAX_PLATE_MATCHES];
+    int count;
+};
+
+// Fixed-size records of the binary stores vehicles.dat and parking_spaces.dat.
+// Each file starts with a store_header; record i sits at sizeof(header) + i * record_size,
+// so a changed record is rewritten in place without touching the rest of the file.
+struct store_header {
+    char magic[4];
+    uint32_t record_size;
+};
+
+struct vehicle_record {
+    uint64_t plate;
+    uint32_t arrival;
+    int32_t total_parking_hours;
+    int32_t total_amount_paid;
+    int32_t parking_count;
+    uint16_t parking_ID;
+    uint8_t membership;
+    uint8_t reserved;
+    char owner_name[OWNER_NAME_SIZE];
+};
+
+struct parking_record {
+    int32_t parking_space_ID;
+    int32_t status;
+    int32_t occupancy_count;
+    int32_t space_revenue;
+};
+
+// vehicles.idx maps plates to vehicles.dat slots: a header, the first plate of every page
+// of INDEX_PAGE_ENTRIES entries, then the entries sorted by plate. Only the page fences
+// stay in memory; one page at a time is read into index_page. It covers the slots below
+// slot_count, later ones are in the trie until save_data merges them in.
+struct index_header {
+    char magic[4];
+    uint32_t entry_size;
+    uint32_t entry_count;
+    uint32_t slot_count;
+};
+
+struct index_entry {
+    uint64_t plate;
+    int32_t slot;
+    uint32_t reserved;
+};
+
+FILE* plate_index = NULL;
+uint64_t* index_fences = NULL;
+int index_count = 0;
+int index_pages = 0;
+int index_slot_count = 0;
+struct index_entry index_page[INDEX_PAGE_ENTRIES];
+int index_page_number = -1;
+
+// Open store files and the vehicles changed since the last checkpoint
+FILE* vehicle_store = NULL;
+FILE* parking_store = NULL;
+int next_vehicle_slot = 0;
+#if FIXED_LOT
+// Dirty vehicles are resident, so the queue only outgrows this if residents do
+struct vehicle_node* fixed_dirty_queue[MAX_RESIDENT_VEHICLES];
+struct vehicle_node** dirty_vehicles = fixed_dirty_queue;
+int dirty_count = 0;
+int dirty_capacity = MAX_RESIDENT_VEHICLES;
+#else
+struct vehicle_node** dirty_vehicles = NULL;
+int dirty_count = 0;
+int dirty_capacity = 0;
+#endif
+
+// Membership thresholds, start from the compiled policy and can be changed at runtime.
+// Changed thresholds are kept in membership_tiers.txt so they survive a restart.
+int golden_hours = GOLDEN_HOURS;
+int premium_hours = PREMIUM_HOURS;
+
+// Structure for one interned owner name, shared by every vehicle with that owner
+struct name_entry {
+    struct name_entry* next;
+    uint32_t hash;
+    char name[];
+};
+
+// Interned owner name hash table. Names are never freed, so entries are packed into blocks.
+struct name_entry** name_table = NULL;
+int name_table_size = 0;
+int name_count = 0;
+
+struct name_block {
+    struct name_block* next;
+    size_t used;
+    char bytes[NAME_BLOCK_SIZE];
+};
+struct name_block* name_blocks = NULL;
+
+// Structure for one whitespace separated field, pointing into the import buffer
+struct field {
+    const char* start;
+    int length;
+};
+
+// Structure for one membership change produced by the re-tiering pass.
+// Changes to vehicles not in memory have vehicle NULL and are written to their store slot.
+struct tier_change {
+    struct vehicle_node* vehicle;
+    int slot;
+    uint64_t plate;
+    int old_membership;
+    int new_membership;
+    struct tier_change* next;
+};
+
 // Function declarations
 struct vehicle_node* create_vehicle_node();
+void set_owner_name(struct vehicle_node* vehicle, const char* name, int length);
 struct parking_node* create_parking_node(int id);
 void initialize_parking_spaces();
-struct vehicle_node* check_registered(char vehicle_num[]);
-struct parking_node* find_parking_space(int membership);
-int calculate_parking_fee(int hours_parked, int membership);
+int encode_plate(const char* text, int length, uint64_t* plate);
+void decode_plate(uint64_t plate, char text[VEHICLE_NUM_SIZE]);
+const char* intern_name(const char* name, int length);
+uint32_t datetime_to_minutes(struct datetime when);
+struct vehicle_node* check_registered(uint64_t plate);
+struct parking_node* space_in_lot(struct parking_node* lot, int id);
+int calculate_parking_fee(int hours_parked, int membership, const struct lot_policy* policy);
+int hours_parked(uint32_t arrival, uint32_t departure);
+int membership_for_hours(int total_hours);
+const char* membership_name(int membership);
+struct trie_node* index_plate(uint64_t plate);
+void scan_cold_records(void (*visit)(const struct vehicle_record* record, int slot, void* context), void* context);
+void scan_store_records(FILE* store, const struct cold_scan* scan,
+                        void (*visit)(const struct vehicle_record* record, int slot, void* context), void* context);
 void park_vehicle();
 void exit_vehicle();
+struct parking_node* park_plate(uint64_t plate, const char* owner_name, uint32_t arrival);
+struct vehicle_node* exit_plate(uint64_t plate, uint32_t departure, int* fee, int* parked_hours);
+void search_plates();
 void display_sorted_by_parkings();
 void display_sorted_by_amount();
 void display_sorted_by_occupancy();
 void display_sorted_by_revenue();
+void retier_vehicles();
+int next_page_wanted();
+void export_report();
+void run_simulation();
 void cleanup();
 void load_data();
 void save_data();
-struct vehicle_node* copy_list(struct vehicle_node* head);
+void export_text_data();
 
+// Function to create a registry vehicle node, called with registry_lock held or while loading
 struct vehicle_node* create_vehicle_node() {
-    struct vehicle_node* new_node = (struct vehicle_node*)malloc(sizeof(struct vehicle_node));
-    if (new_node == NULL) {
-        printf("Memory allocation failed!\n");
-        exit(1);
+    struct vehicle_node* new_node = spare_vehicles;
+    if (new_node != NULL) {
+        spare_vehicles = new_node->next;
+#if FIXED_LOT
+    } else if (fixed_vehicles_used < MAX_RESIDENT_VEHICLES) {
+        new_node = &fixed_vehicle_pool[fixed_vehicles_used++];
+#endif
+    } else {
+        if (vehicle_blocks == NULL || vehicle_blocks->used == VEHICLE_BLOCK_SIZE) {
+            struct vehicle_block* block = (struct vehicle_block*)malloc(sizeof(struct vehicle_block));
+            if (block == NULL) {
+                printf("Memory allocation failed!\n");
+                exit(1);
+            }
+            block->used = 0;
+            block->next = vehicle_blocks;
+            vehicle_blocks = block;
+        }
+        new_node = &vehicle_blocks->nodes[vehicle_blocks->used++];
     }
     new_node->next = NULL;
+    new_node->plate = 0;
+    set_owner_name(new_node, "", 0);
+    new_node->arrival = 0;
     new_node->total_parking_hours = 0;
     new_node->total_amount_paid = 0;
     new_node->parking_count = 0;
     new_node->membership = NONE;
     new_node->parking_ID = 0;
+    new_node->dirty = 0;
+    new_node->referenced = 0;
+    new_node->slot = -1;
     return new_node;
 }
 
+// Function to give a vehicle its owner name. With FIXED_LOT the name is copied into the
+// node, otherwise it is interned, so call it with registry_lock held or while loading.
+void set_owner_name(struct vehicle_node* vehicle, const char* name, int length) {
+#if FIXED_LOT
+    if (length > OWNER_NAME_SIZE - 1) length = OWNER_NAME_SIZE - 1;
+    memcpy(vehicle->owner_name, name, length);
+    vehicle->owner_name[length] = '\0';
+#else
+    vehicle->owner_name = length > 0 ? intern_name(name, length) : "";
+#endif
+}
+
+// Function to give a registry vehicle node back for reuse
+void free_vehicle_node(struct vehicle_node* vehicle) {
+    vehicle->next = spare_vehicles;
+    spare_vehicles = vehicle;
+}
+
 // Function to create new parking node
 struct parking_node* create_parking_node(int id) {
     struct parking_node* new_node = (struct parking_node*)malloc(sizeof(struct parking_node));
@@ -95,768 +510,3802 @@ struct parking_node* create_parking_node(int id) {
     new_node->status = FREE;
     new_node->occupancy_count = 0;
     new_node->space_revenue = 0;
+    new_node->dirty = 0;
+    new_node->occupant = 0;
     new_node->next = NULL;
     return new_node;
 }
 
-// Function to initialize parking spaces
-void initialize_parking_spaces() {
+// Function to build a lot of free spaces numbered from 1
+struct parking_node* create_parking_lot(int space_count) {
+    struct parking_node* lot = NULL;
     struct parking_node* current = NULL;
     
-    for (int i = 0; i < MAX_PARKING_SPACES; i++) {
+    for (int i = 0; i < space_count; i++) {
         struct parking_node* new_node = create_parking_node(i + 1);
         
-        if (parking_list == NULL) {
-            parking_list = new_node;
+        if (lot == NULL) {
+            lot = new_node;
             current = new_node;
         } else {
             current->next = new_node;
             current = new_node;
         }
     }
+    return lot;
 }
 
-// Function to check if a vehicle is already registered
-struct vehicle_node* check_registered(char vehicle_num[]) {
-    struct vehicle_node* current = vehicle_list;
-    while (current != NULL) {
-        if (strcmp(current->vehicle_num, vehicle_num) == 0) {
-            return current;
-        }
-        current = current->next;
+// Function to initialize parking spaces
+void initialize_parking_spaces() {
+#if FIXED_LOT
+    for (int i = 0; i < MAX_PARKING_SPACES; i++) {
+        fixed_spaces[i].parking_space_ID = i + 1;
+        fixed_spaces[i].status = FREE;
+        fixed_spaces[i].occupancy_count = 0;
+        fixed_spaces[i].space_revenue = 0;
+        fixed_spaces[i].dirty = 0;
+        fixed_spaces[i].occupant = 0;
+        fixed_spaces[i].next = i + 1 < MAX_PARKING_SPACES ? &fixed_spaces[i + 1] : NULL;
     }
-    return NULL;
+    parking_list = fixed_spaces;
+    free_space_mask = SPACE_BITS(1, MAX_PARKING_SPACES);
+#else
+    parking_list = create_parking_lot(MAX_PARKING_SPACES);
+#endif
 }
 
-// Function to find a parking space based on membership
-struct parking_node* find_parking_space(int membership) {
-    struct parking_node* current = parking_list;
-    int space_number = 1;
-    
-    while (current != NULL) {
-        if (current->status == FREE) {
-            if ((membership == GOLD && space_number <= 10) ||
-                (membership == PREMIUM && space_number > 10 && space_number <= 20) ||
-                (membership == NONE && space_number > 20)) {
-                return current;
+// Packs a vehicle number into 64 bits: one base-37 digit per character, 0 as padding.
+// Digits sort before letters and shorter numbers before longer ones, so packed
+// plates compare in the same order as the text. Returns 0 if the text cannot be packed.
+int encode_plate(const char* text, int length, uint64_t* plate) {
+    uint64_t result = 0;
+
+    if (length <= 0 || length > PLATE_MAX_LENGTH) return 0;
+    for (int i = 0; i < PLATE_MAX_LENGTH; i++) {
+        int digit = 0;
+        if (i < length) {
+            char c = text[i];
+            if (c >= '0' && c <= '9') {
+                digit = 1 + (c - '0');
+            } else if (c >= 'A' && c <= 'Z') {
+                digit = 11 + (c - 'A');
+            } else if (c >= 'a' && c <= 'z') {
+                digit = 11 + (c - 'a');
+            } else {
+                return 0;
             }
         }
-        current = current->next;
-        space_number++;
+        result = result * PLATE_RADIX + digit;
     }
-    return NULL;
+    *plate = result;
+    return 1;
 }
 
-// Helper function to calculate parking fee
-int calculate_parking_fee(int hours_parked, int membership) {
-    int fee = BASE_FEES;
-    if (hours_parked > 3) {
-        fee += (hours_parked - 3) * EXTRA_FEES;
-    }
-    if (membership > 0) {
-        fee = (int)(fee * (1.0 - DISCOUNT));
+// Unpacks a vehicle number produced by encode_plate
+void decode_plate(uint64_t plate, char text[VEHICLE_NUM_SIZE]) {
+    int length = 0;
+
+    for (int i = PLATE_MAX_LENGTH - 1; i >= 0; i--) {
+        int digit = (int)(plate % PLATE_RADIX);
+        plate /= PLATE_RADIX;
+        if (digit == 0) {
+            text[i] = '\0';
+        } else {
+            text[i] = digit <= 10 ? (char)('0' + digit - 1) : (char)('A' + digit - 11);
+            if (length == 0) length = i + 1;
+        }
     }
-    return fee;
+    text[length] = '\0';
 }
 
-// Helper functions for date calculations
-int days_in_month(int month) {
-    int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    return days[month - 1];
+uint32_t hash_name(const char* name, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
 }
 
-int totaldays(int date, int month, int year) {
-    int days = 0;
-    for (int i = 1990; i < year; i++) {
-        days += 365;
-    }
-    for (int i = 1; i < month; i++) {
-        days += days_in_month(i);
+// Function to grow the name table once chains get long
+void grow_name_table() {
+    int new_size = name_table_size == 0 ? NAME_TABLE_INITIAL_SIZE : name_table_size * 2;
+    struct name_entry** new_table = (struct name_entry**)calloc(new_size, sizeof(struct name_entry*));
+    if (new_table == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
     }
-    days += date;
-    return days;
-}
 
-int date_difference(int date1, int month1, int year1, int date2, int month2, int year2) {
-    int days1 = totaldays(date1, month1, year1);
-    int days2 = totaldays(date2, month2, year2);
-    return days2 - days1;
+    for (int i = 0; i < name_table_size; i++) {
+        struct name_entry* entry = name_table[i];
+        while (entry != NULL) {
+            struct name_entry* next = entry->next;
+            int bucket = entry->hash & (new_size - 1);
+            entry->next = new_table[bucket];
+            new_table[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(name_table);
+    name_table = new_table;
+    name_table_size = new_size;
 }
 
-int hours_parked(struct datetime arrival, struct datetime departure) {
-    int total_days_difference = date_difference(arrival.date, arrival.month, arrival.year,
-                                              departure.date, departure.month, departure.year);
-    int total_hours = total_days_difference * 24 + (departure.time - arrival.time);
-    if (total_hours < 0) {
-        total_hours += 24;
+// Returns the shared copy of an owner name, adding it on first use
+const char* intern_name(const char* name, int length) {
+    if (name_count >= name_table_size) {
+        grow_name_table();
     }
-    return total_hours;
-}
 
-// Function to park a vehicle
-void park_vehicle() {
-    char vehicle_num[10], owner_name[20];
-    struct datetime arrival;
+    uint32_t hash = hash_name(name, length);
+    int bucket = hash & (name_table_size - 1);
+    struct name_entry* entry = name_table[bucket];
+    while (entry != NULL) {
+        if (entry->hash == hash && strncmp(entry->name, name, length) == 0 && entry->name[length] == '\0') {
+            return entry->name;
+        }
+        entry = entry->next;
+    }
 
-    printf("Enter vehicle number: ");
-    scanf("%s", vehicle_num);
-    printf("Enter arrival time (24-hour format): ");
-    scanf("%d", &arrival.time);
-    printf("Enter arrival date: ");
-    scanf("%d", &arrival.date);
-    printf("Enter arrival month: ");
-    scanf("%d", &arrival.month);
-    printf("Enter arrival year: ");
-    scanf("%d", &arrival.year);
+    size_t entry_size = (sizeof(struct name_entry) + length + 1 + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    if (name_blocks == NULL || name_blocks->used + entry_size > NAME_BLOCK_SIZE) {
+        struct name_block* block = (struct name_block*)malloc(sizeof(struct name_block));
+        if (block == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(1);
+        }
+        block->used = 0;
+        block->next = name_blocks;
+        name_blocks = block;
+    }
+    entry = (struct name_entry*)(name_blocks->bytes + name_blocks->used);
+    name_blocks->used += entry_size;
+    entry->hash = hash;
+    memcpy(entry->name, name, length);
+    entry->name[length] = '\0';
+    entry->next = name_table[bucket];
+    name_table[bucket] = entry;
+    name_count++;
+    return entry->name;
+}
 
-    struct vehicle_node* existing_vehicle = check_registered(vehicle_num);
-    struct vehicle_node* vehicle;
+void lock_registry() {
+#if PARKING_THREADS
+    pthread_mutex_lock(&registry_lock);
+#endif
+}
 
-    if (existing_vehicle == NULL) {
-        printf("Enter owner's name: ");
-        scanf("%s", owner_name);
+void unlock_registry() {
+#if PARKING_THREADS
+    pthread_mutex_unlock(&registry_lock);
+#endif
+}
 
-        vehicle = create_vehicle_node();
-        strcpy(vehicle->vehicle_num, vehicle_num);
-        strcpy(vehicle->owner_name, owner_name);
-        vehicle->membership = NONE;
-        vehicle->total_parking_hours = 0;
-        vehicle->total_amount_paid = 0;
-        vehicle->parking_count = 0;
+// Splits a packed plate back into its base-37 digits, returns the number of characters
+int plate_digits(uint64_t plate, unsigned char digits[PLATE_MAX_LENGTH]) {
+    int length = 0;
 
-        vehicle->next = vehicle_list;
-        vehicle_list = vehicle;
-        vehicle_count++;
-    } else {
-        vehicle = existing_vehicle;
+    for (int i = PLATE_MAX_LENGTH - 1; i >= 0; i--) {
+        digits[i] = (unsigned char)(plate % PLATE_RADIX);
+        plate /= PLATE_RADIX;
+        if (digits[i] != 0 && length == 0) length = i + 1;
     }
+    return length;
+}
 
-    vehicle->arrival = arrival;
+// Edit distance between two plates, counting insertions, deletions and substitutions
+int plate_distance(uint64_t plate1, uint64_t plate2) {
+    unsigned char a[PLATE_MAX_LENGTH], b[PLATE_MAX_LENGTH];
+    int row[PLATE_MAX_LENGTH + 1];
+    int length1 = plate_digits(plate1, a);
+    int length2 = plate_digits(plate2, b);
 
-    struct parking_node* parking_space = find_parking_space(vehicle->membership);
-    if (parking_space != NULL) {
-        vehicle->parking_ID = parking_space->parking_space_ID;
-        parking_space->status = OCCUPIED;
-        parking_space->occupancy_count++;
-        printf("Vehicle parked at space %d\n", parking_space->parking_space_ID);
-    } else {
-        printf("No suitable parking space available.\n");
+    for (int j = 0; j <= length2; j++) row[j] = j;
+    for (int i = 1; i <= length1; i++) {
+        int diagonal = row[0];
+        row[0] = i;
+        for (int j = 1; j <= length2; j++) {
+            int above = row[j];
+            int best = diagonal + (a[i - 1] != b[j - 1]);
+            if (above + 1 < best) best = above + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            diagonal = above;
+        }
     }
+    return row[length2];
 }
 
-// Function to handle vehicle exit
-void exit_vehicle() {
-    char vehicle_num[10];
-    struct datetime departure;
-
-    printf("Enter vehicle number: ");
-    scanf("%s", vehicle_num);
-    printf("Enter departure time (24-hour format): ");
-    scanf("%d", &departure.time);
-    printf("Enter departure date: ");
-    scanf("%d", &departure.date);
-    printf("Enter departure month: ");
-    scanf("%d", &departure.month);
-    printf("Enter departure year: ");
-    scanf("%d", &departure.year);
+// Function to add a vehicle number to the search trie, called with registry_lock held.
+// Returns the plate's terminal node; the caller sets its vehicle or slot.
+struct trie_node* index_plate(uint64_t plate) {
+    unsigned char digits[PLATE_MAX_LENGTH];
+    int length = plate_digits(plate, digits);
 
-    struct vehicle_node* vehicle = check_registered(vehicle_num);
-    if (vehicle != NULL) {
-        int parked_hours = hours_parked(vehicle->arrival, departure);
-        vehicle->total_parking_hours += parked_hours;
-
-        int fee = calculate_parking_fee(parked_hours, vehicle->membership);
-        vehicle->total_amount_paid += fee;
-        vehicle->parking_count++;
-
-        struct parking_node* current = parking_list;
-        while (current != NULL) {
-            if (current->parking_space_ID == vehicle->parking_ID) {
-                current->status = FREE;
-                current->space_revenue += fee;
-                break;
+    struct trie_node** link = &plate_trie;
+    struct trie_node* node = NULL;
+    for (int i = 0; i < length; i++) {
+        while (*link != NULL && (*link)->digit < digits[i]) {
+            link = &(*link)->sibling;
+        }
+        if (*link == NULL || (*link)->digit != digits[i]) {
+            struct trie_node* new_node = spare_trie_nodes;
+            if (new_node != NULL) {
+                spare_trie_nodes = new_node->child;
+#if FIXED_LOT
+            } else if (fixed_trie_nodes_used < MAX_RESIDENT_VEHICLES * PLATE_MAX_LENGTH) {
+                new_node = &fixed_trie_pool[fixed_trie_nodes_used++];
+#endif
+            } else {
+                if (trie_blocks == NULL || trie_blocks->used == TRIE_BLOCK_SIZE) {
+                    struct trie_block* block = (struct trie_block*)malloc(sizeof(struct trie_block));
+                    if (block == NULL) {
+                        printf("Memory allocation failed!\n");
+                        exit(1);
+                    }
+                    block->used = 0;
+                    block->next = trie_blocks;
+                    trie_blocks = block;
+                }
+                new_node = &trie_blocks->nodes[trie_blocks->used++];
             }
-            current = current->next;
+            new_node->digit = digits[i];
+            new_node->terminal = 0;
+            new_node->slot = -1;
+            new_node->vehicle = NULL;
+            new_node->child = NULL;
+            new_node->sibling = *link;
+            *link = new_node;
         }
+        node = *link;
+        link = &node->child;
+    }
+    if (node != NULL) node->terminal = 1;
+    return node;
+}
+
+// Removes a plate from the trie and gives back the nodes only it was using, so the trie
+// stays the size of what is resident instead of growing with every vehicle ever loaded
+void unindex_plate(uint64_t plate) {
+    unsigned char digits[PLATE_MAX_LENGTH];
+    int length = plate_digits(plate, digits);
+    struct trie_node** path[PLATE_MAX_LENGTH];
 
-        if (vehicle->total_parking_hours >= GOLDEN_HOURS) {
-            vehicle->membership = GOLD;
-        } else if (vehicle->total_parking_hours >= PREMIUM_HOURS) {
-            vehicle->membership = PREMIUM;
+    struct trie_node** link = &plate_trie;
+    for (int i = 0; i < length; i++) {
+        while (*link != NULL && (*link)->digit < digits[i]) {
+            link = &(*link)->sibling;
         }
+        if (*link == NULL || (*link)->digit != digits[i]) return;
+        path[i] = link;
+        link = &(*link)->child;
+    }
+    if (length == 0) return;
 
-        printf("\nVehicle Exit Summary:\n");
-        printf("Hours parked: %d\n", parked_hours);
-        printf("Parking fee: %d Rs\n", fee);
-        printf("Total parking hours: %d\n", vehicle->total_parking_hours);
-        printf("Membership status: %s\n", 
-               vehicle->membership == GOLD ? "GOLD" : 
-               vehicle->membership == PREMIUM ? "PREMIUM" : "NONE");
-    } else {
-        printf("Vehicle not found in the system.\n");
+    struct trie_node* node = *path[length - 1];
+    node->terminal = 0;
+    node->vehicle = NULL;
+    node->slot = -1;
+    for (int i = length - 1; i >= 0; i--) {
+        node = *path[i];
+        if (node->terminal || node->child != NULL) break;
+        *path[i] = node->sibling;
+        node->child = spare_trie_nodes;
+        spare_trie_nodes = node;
     }
 }
 
-// Merge functions for sorting
-struct vehicle_node* merge_by_parkings(struct vehicle_node* head1, struct vehicle_node* head2) {
-    struct vehicle_node* result = NULL;
-    struct vehicle_node* tail = NULL;
+// Returns the terminal trie node of a registered plate, or NULL if it is not registered
+struct trie_node* find_indexed_plate(uint64_t plate) {
+    unsigned char digits[PLATE_MAX_LENGTH];
+    int length = plate_digits(plate, digits);
 
-    while (head1 != NULL && head2 != NULL) {
-        if (head1->parking_count >= head2->parking_count) {
-            if (result == NULL) {
-                result = tail = head1;
-            } else {
-                tail->next = head1;
-                tail = head1;
-            }
-            head1 = head1->next;
-        } else {
-            if (result == NULL) {
-                result = tail = head2;
-            } else {
-                tail->next = head2;
-                tail = head2;
-            }
-            head2 = head2->next;
+    struct trie_node* node = NULL;
+    struct trie_node* level = plate_trie;
+    for (int i = 0; i < length; i++) {
+        while (level != NULL && level->digit < digits[i]) {
+            level = level->sibling;
         }
+        if (level == NULL || level->digit != digits[i]) return NULL;
+        node = level;
+        level = node->child;
     }
+    return node != NULL && node->terminal ? node : NULL;
+}
 
-    if (head1 != NULL) {
-        if (result == NULL) result = head1;
-        else tail->next = head1;
+int compare_indexed_plates_descending(const void* a, const void* b) {
+    uint64_t plate1 = ((const struct indexed_plate*)a)->plate;
+    uint64_t plate2 = ((const struct indexed_plate*)b)->plate;
+    return (plate1 < plate2) - (plate1 > plate2);
+}
+
+// Function to index every loaded vehicle at once: the resident list plus the cold
+// plates and slots collected while loading that vehicles.idx does not cover. Inserting in descending order
+// puts each new node at the head of its sibling list, so no list is ever scanned.
+void build_plate_index(struct indexed_plate* cold, int cold_count) {
+    int count = resident_count + cold_count;
+    if (count == 0) return;
+
+    struct indexed_plate* plates = (struct indexed_plate*)malloc(count * sizeof(struct indexed_plate));
+    if (plates == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
     }
-    if (head2 != NULL) {
-        if (result == NULL) result = head2;
-        else tail->next = head2;
+    int i = 0;
+    for (struct vehicle_node* current = vehicle_list; current != NULL; current = current->next, i++) {
+        plates[i].plate = current->plate;
+        plates[i].slot = -1;
+        plates[i].vehicle = current;
     }
+    if (cold_count > 0) {
+        memcpy(plates + i, cold, cold_count * sizeof(struct indexed_plate));
+    }
+    qsort(plates, count, sizeof(struct indexed_plate), compare_indexed_plates_descending);
+    for (i = 0; i < count; i++) {
+        struct trie_node* entry = index_plate(plates[i].plate);
+        entry->vehicle = plates[i].vehicle;
+        entry->slot = plates[i].slot;
+    }
+    free(plates);
+}
 
-    return result;
+// Reads a page of vehicles.idx into index_page unless it is there already, returns its entry count
+int read_index_page(int page) {
+    int first = page * INDEX_PAGE_ENTRIES;
+    int count = index_count - first < INDEX_PAGE_ENTRIES ? index_count - first : INDEX_PAGE_ENTRIES;
+    if (page == index_page_number) return count;
+
+    long position = (long)sizeof(struct index_header) + (long)index_pages * (long)sizeof(uint64_t) +
+                    (long)first * (long)sizeof(struct index_entry);
+    fseek(plate_index, position, SEEK_SET);
+    if (fread(index_page, sizeof(struct index_entry), count, plate_index) != (size_t)count) {
+        printf("Error: Unable to read vehicles.idx.\n");
+        index_page_number = -1;
+        return 0;
+    }
+    index_page_number = page;
+    return count;
 }
 
-struct vehicle_node* merge_by_amount(struct vehicle_node* head1, struct vehicle_node* head2) {
-    struct vehicle_node* result = NULL;
-    struct vehicle_node* temp = NULL;
-    
-    while (head1 != NULL && head2 != NULL) {
-        if (head1->total_amount_paid >= head2->total_amount_paid) {
-            if (result == NULL) {
-                result = temp = head1;
-            } else {
-                temp->next = head1;
-                temp = temp->next;
-            }
-            head1 = head1->next;
+// Returns the position in vehicles.idx of the first entry whose plate is not below the given one
+int index_seek(uint64_t plate) {
+    int low = 0;
+    int high = index_pages;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (index_fences[middle] < plate) {
+            low = middle + 1;
         } else {
-            if (result == NULL) {
-                result = temp = head2;
-            } else {
-                temp->next = head2;
-                temp = temp->next;
-            }
-            head2 = head2->next;
+            high = middle;
         }
     }
-    
-    if (head1 != NULL) {
-        if (result == NULL) result = head1;
-        else temp->next = head1;
-    }
-    if (head2 != NULL) {
-        if (result == NULL) result = head2;
-        else temp->next = head2;
+    // Page low starts at or after the plate, so the entry is in the page before it or first in page low
+    if (low == 0) return 0;
+    int page = low - 1;
+    int count = read_index_page(page);
+    int first = 0;
+    while (first < count) {
+        int middle = (first + count) / 2;
+        if (index_page[middle].plate < plate) {
+            first = middle + 1;
+        } else {
+            count = middle;
+        }
     }
-    
-    return result;
+    return page * INDEX_PAGE_ENTRIES + first;
 }
 
-struct parking_node* merge_by_occupancy(struct parking_node* head1, struct parking_node* head2) {
-    struct parking_node* result = NULL;
-    struct parking_node* tail = NULL;
+uint64_t index_plate_at(int position) {
+    read_index_page(position / INDEX_PAGE_ENTRIES);
+    return index_page[position % INDEX_PAGE_ENTRIES].plate;
+}
 
-    while (head1 != NULL && head2 != NULL) {
-        if (head1->occupancy_count >= head2->occupancy_count) {
-            if (result == NULL) {
-                result = tail = head1;
-            } else {
-                tail->next = head1;
-                tail = head1;
+// Returns the vehicles.dat slot of a plate in vehicles.idx, or -1 if it is not in it
+int lookup_plate_index(uint64_t plate) {
+    if (index_count == 0) return -1;
+    int position = index_seek(plate);
+    if (position == index_count || index_plate_at(position) != plate) return -1;
+    return index_page[position % INDEX_PAGE_ENTRIES].slot;
+}
+
+void add_match(struct plate_matches* matches, uint64_t plate, int distance) {
+    if (matches->count < MAX_PLATE_MATCHES) {
+        matches->plates[matches->count] = plate;
+        matches->distances[matches->count] = distance;
+        matches->count++;
+    }
+}
+
+void collect_trie_plates(struct trie_node* node, uint64_t prefix, int depth, struct plate_matches* matches) {
+    while (node != NULL && matches->count < MAX_PLATE_MATCHES) {
+        uint64_t value = prefix * PLATE_RADIX + node->digit;
+        if (node->terminal) {
+            uint64_t plate = value;
+            for (int i = depth + 1; i < PLATE_MAX_LENGTH; i++) plate *= PLATE_RADIX;
+            add_match(matches, plate, 0);
+        }
+        collect_trie_plates(node->child, value, depth + 1, matches);
+        node = node->sibling;
+    }
+}
+
+// Merges two sorted match lists into the first, a plate found in both is kept once
+void merge_matches(struct plate_matches* matches, const struct plate_matches* more) {
+    struct plate_matches merged;
+    int i = 0;
+    int j = 0;
+
+    merged.count = 0;
+    while (merged.count < MAX_PLATE_MATCHES && (i < matches->count || j < more->count)) {
+        if (j == more->count || (i < matches->count && matches->plates[i] <= more->plates[j])) {
+            if (j < more->count && more->plates[j] == matches->plates[i]) j++;
+            add_match(&merged, matches->plates[i], matches->distances[i]);
+            i++;
+        } else {
+            add_match(&merged, more->plates[j], more->distances[j]);
+            j++;
+        }
+    }
+    *matches = merged;
+}
+
+// Adds the plates of vehicles.idx from low up to (not including) high, in order
+void collect_index_plates(uint64_t low, uint64_t high, struct plate_matches* matches) {
+    if (index_count == 0) return;
+    for (int position = index_seek(low); position < index_count && matches->count < MAX_PLATE_MATCHES; position++) {
+        uint64_t plate = index_plate_at(position);
+        if (plate >= high) break;
+        if (matches->count > 0 && matches->plates[matches->count - 1] == plate) continue;
+        add_match(matches, plate, 0);
+    }
+}
+
+void find_trie_prefix(const unsigned char* digits, int length, struct plate_matches* matches) {
+    struct trie_node* node = plate_trie;
+    uint64_t value = 0;
+    for (int i = 0; i < length; i++) {
+        while (node != NULL && node->digit < digits[i]) node = node->sibling;
+        if (node == NULL || node->digit != digits[i]) return;
+        value = value * PLATE_RADIX + node->digit;
+        if (i == length - 1) break;
+        node = node->child;
+    }
+    if (node->terminal) {
+        uint64_t plate = value;
+        for (int i = length; i < PLATE_MAX_LENGTH; i++) plate *= PLATE_RADIX;
+        add_match(matches, plate, 0);
+    }
+    collect_trie_plates(node->child, value, length, matches);
+}
+
+// Finds registered plates starting with the given text, in sorted order.
+// Packed plates keep text order, so in vehicles.idx they form one run starting at the padded prefix.
+void find_plates_by_prefix(const char* prefix, struct plate_matches* matches) {
+    unsigned char digits[PLATE_MAX_LENGTH];
+    uint64_t packed;
+    int length = (int)strlen(prefix);
+
+    matches->count = 0;
+    if (!encode_plate(prefix, length, &packed)) return;
+    plate_digits(packed, digits);
+    find_trie_prefix(digits, length, matches);
+
+    uint64_t run = 1;
+    for (int i = length; i < PLATE_MAX_LENGTH; i++) run *= PLATE_RADIX;
+    struct plate_matches stored;
+    stored.count = 0;
+    collect_index_plates(packed, packed + run, &stored);
+    merge_matches(matches, &stored);
+}
+
+// Walks the trie keeping one row of the edit distance table per level. A branch is
+// dropped as soon as every entry in its row is over max_distance, so only plates
+// that can still match are visited.
+void search_trie_similar(struct trie_node* node, uint64_t prefix, int depth,
+                         const unsigned char* target, int target_length,
+                         const int* previous_row, int max_distance, struct plate_matches* matches) {
+    int row[PLATE_MAX_LENGTH + 1];
+
+    for (; node != NULL && matches->count < MAX_PLATE_MATCHES; node = node->sibling) {
+        int smallest = row[0] = previous_row[0] + 1;
+        for (int j = 1; j <= target_length; j++) {
+            int best = previous_row[j - 1] + (target[j - 1] != node->digit);
+            if (previous_row[j] + 1 < best) best = previous_row[j] + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            if (best < smallest) smallest = best;
+        }
+
+        uint64_t value = prefix * PLATE_RADIX + node->digit;
+        if (node->terminal && row[target_length] <= max_distance) {
+            uint64_t plate = value;
+            for (int i = depth + 1; i < PLATE_MAX_LENGTH; i++) plate *= PLATE_RADIX;
+            add_match(matches, plate, row[target_length]);
+        }
+        if (smallest <= max_distance && depth + 1 < PLATE_MAX_LENGTH) {
+            search_trie_similar(node->child, value, depth + 1, target, target_length,
+                                row, max_distance, matches);
+        }
+    }
+}
+
+// The same search over the sorted entries of vehicles.idx. rows[d] is the edit distance
+// row after the first d digits of path, the last plate visited, so a plate sharing a prefix
+// with it reuses those rows. When every entry of a row is over max_distance, the whole run
+// of plates with that prefix is skipped by seeking past it.
+void search_index_similar(const unsigned char* target, int target_length, int max_distance,
+                          struct plate_matches* matches) {
+    int rows[PLATE_MAX_LENGTH + 1][PLATE_MAX_LENGTH + 1];
+    unsigned char path[PLATE_MAX_LENGTH];
+    int valid = 0;
+
+    for (int j = 0; j <= target_length; j++) rows[0][j] = j;
+    int position = 0;
+    while (position < index_count && matches->count < MAX_PLATE_MATCHES) {
+        unsigned char digits[PLATE_MAX_LENGTH];
+        uint64_t plate = index_plate_at(position);
+        int length = plate_digits(plate, digits);
+
+        int depth = 0;
+        while (depth < valid && depth < length && path[depth] == digits[depth]) depth++;
+        int dropped = 0;
+        for (; depth < length; depth++) {
+            const int* previous_row = rows[depth];
+            int* row = rows[depth + 1];
+            int smallest = row[0] = previous_row[0] + 1;
+            for (int j = 1; j <= target_length; j++) {
+                int best = previous_row[j - 1] + (target[j - 1] != digits[depth]);
+                if (previous_row[j] + 1 < best) best = previous_row[j] + 1;
+                if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+                row[j] = best;
+                if (best < smallest) smallest = best;
+            }
+            path[depth] = digits[depth];
+            if (smallest > max_distance) {
+                dropped = 1;
+                break;
+            }
+        }
+
+        if (dropped) {
+            uint64_t next = 0;
+            for (int i = 0; i <= depth; i++) next = next * PLATE_RADIX + path[i];
+            next++;
+            for (int i = depth + 1; i < PLATE_MAX_LENGTH; i++) next *= PLATE_RADIX;
+            valid = depth;
+            position = index_seek(next);
+            continue;
+        }
+        valid = length;
+        if (rows[length][target_length] <= max_distance &&
+            (matches->count == 0 || matches->plates[matches->count - 1] != plate)) {
+            add_match(matches, plate, rows[length][target_length]);
+        }
+        position++;
+    }
+}
+
+// Finds registered plates within max_distance edits of the given one, in sorted order
+void find_similar_plates(uint64_t plate, int max_distance, struct plate_matches* matches) {
+    unsigned char target[PLATE_MAX_LENGTH];
+    int first_row[PLATE_MAX_LENGTH + 1];
+    int target_length = plate_digits(plate, target);
+
+    for (int j = 0; j <= target_length; j++) first_row[j] = j;
+    matches->count = 0;
+    search_trie_similar(plate_trie, 0, 0, target, target_length, first_row, max_distance, matches);
+
+    struct plate_matches stored;
+    stored.count = 0;
+    search_index_similar(target, target_length, max_distance, &stored);
+    merge_matches(matches, &stored);
+}
+
+// Queues a vehicle for the next checkpoint, called with registry_lock held
+void mark_vehicle_dirty(struct vehicle_node* vehicle) {
+    if (vehicle->dirty) return;
+    if (dirty_count == dirty_capacity) {
+        int new_capacity = dirty_capacity == 0 ? 64 : dirty_capacity * 2;
+        struct vehicle_node** grown;
+#if FIXED_LOT
+        if (dirty_vehicles == fixed_dirty_queue) {
+            grown = (struct vehicle_node**)malloc(new_capacity * sizeof(struct vehicle_node*));
+            if (grown != NULL) memcpy(grown, dirty_vehicles, dirty_count * sizeof(struct vehicle_node*));
+        } else
+#endif
+        grown = (struct vehicle_node**)realloc(dirty_vehicles, new_capacity * sizeof(struct vehicle_node*));
+        if (grown == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(1);
+        }
+        dirty_vehicles = grown;
+        dirty_capacity = new_capacity;
+    }
+    vehicle->dirty = 1;
+    dirty_vehicles[dirty_count++] = vehicle;
+}
+
+// Function to record whether the vehicle in a store slot is in memory
+void set_slot_resident(int slot, int resident) {
+    if (slot >= resident_slots_size) {
+        int new_size = resident_slots_size == 0 ? 1024 : resident_slots_size;
+        while (new_size <= slot) new_size *= 2;
+        unsigned char* grown = (unsigned char*)realloc(resident_slots, new_size / 8);
+        if (grown == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(1);
+        }
+        memset(grown + resident_slots_size / 8, 0, (new_size - resident_slots_size) / 8);
+        resident_slots = grown;
+        resident_slots_size = new_size;
+    }
+    if (resident) {
+        resident_slots[slot / 8] |= (unsigned char)(1 << (slot % 8));
+    } else {
+        resident_slots[slot / 8] &= (unsigned char)~(1 << (slot % 8));
+    }
+}
+
+int slot_is_resident(int slot) {
+    return slot < resident_slots_size && (resident_slots[slot / 8] >> (slot % 8)) & 1;
+}
+
+// Membership of a stored record. The byte is used as an index, so one that is not a known
+// tier is recomputed from the hours instead of trusted.
+int record_membership(const struct vehicle_record* record) {
+    return record->membership <= GOLD ? record->membership : membership_for_hours(record->total_parking_hours);
+}
+
+int scan_slot_resident(const struct cold_scan* scan, int slot) {
+    return slot < scan->resident_size && (scan->resident[slot / 8] >> (slot % 8)) & 1;
+}
+
+// Whether a snapshot is reading the record in a slot right now, called with registry_lock held
+int slot_being_scanned(int slot) {
+    for (struct cold_scan* scan = active_cold_scans; scan != NULL; scan = scan->next) {
+        if (slot < scan->slot_count && !scan_slot_resident(scan, slot)) return 1;
+    }
+    return 0;
+}
+
+// Records which slots of vehicles.dat hold cold vehicles right now and registers the scan,
+// called with registry_lock held. Until end_cold_scan those records are not rewritten,
+// so the scan can read them through its own file handle without the lock.
+void begin_cold_scan(struct cold_scan* scan) {
+    scan->slot_count = vehicle_count > resident_count ? next_vehicle_slot : 0;
+    scan->resident = NULL;
+    scan->resident_size = 0;
+    if (scan->slot_count == 0) return;
+
+    scan->resident_size = resident_slots_size < scan->slot_count ? resident_slots_size : scan->slot_count;
+    scan->resident = (unsigned char*)malloc(scan->resident_size / 8 + 1);
+    if (scan->resident == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    if (scan->resident_size > 0) {
+        memcpy(scan->resident, resident_slots, (scan->resident_size + 7) / 8);
+    }
+    scan->next = active_cold_scans;
+    active_cold_scans = scan;
+}
+
+// Removes a finished scan from active_cold_scans, called with registry_lock held
+void end_cold_scan(struct cold_scan* scan) {
+    if (scan->slot_count == 0) return;
+    struct cold_scan** link = &active_cold_scans;
+    while (*link != scan) link = &(*link)->next;
+    *link = scan->next;
+    free(scan->resident);
+#if PARKING_THREADS
+    pthread_cond_broadcast(&cold_scans_done);
+#endif
+}
+
+// Function to create a vehicle node from its vehicles.dat record
+struct vehicle_node* vehicle_from_record(const struct vehicle_record* record, int slot) {
+    struct vehicle_node* new_vehicle = create_vehicle_node();
+    new_vehicle->plate = record->plate;
+    new_vehicle->arrival = record->arrival;
+    new_vehicle->total_parking_hours = record->total_parking_hours;
+    new_vehicle->total_amount_paid = record->total_amount_paid;
+    new_vehicle->parking_count = record->parking_count;
+    new_vehicle->parking_ID = record->parking_ID;
+    new_vehicle->membership = record_membership(record);
+    set_owner_name(new_vehicle, record->owner_name, (int)strnlen(record->owner_name, OWNER_NAME_SIZE));
+    new_vehicle->slot = slot;
+    return new_vehicle;
+}
+
+// Returns the space a stored vehicle says it is parked in, if that space is occupied and no
+// loaded vehicle has claimed it yet. Occupants are not saved, so after a restart the space
+// goes to the first vehicle read that names it; exits clear parking_ID, so that is its occupant.
+struct parking_node* unclaimed_space(int parking_ID) {
+    if (parking_ID == 0) return NULL;
+    struct parking_node* parking_space = space_in_lot(parking_list, parking_ID);
+    if (parking_space == NULL || parking_space->status != OCCUPIED || parking_space->occupant != 0) return NULL;
+    return parking_space;
+}
+
+void claim_space(const struct vehicle_node* vehicle) {
+    struct parking_node* parking_space = unclaimed_space(vehicle->parking_ID);
+    if (parking_space != NULL) parking_space->occupant = vehicle->plate;
+}
+
+// Helper function to check whether a vehicle is the one holding its space right now
+int vehicle_is_parked(const struct vehicle_node* vehicle) {
+    if (vehicle->parking_ID == 0) return 0;
+    struct parking_node* parking_space = space_in_lot(parking_list, vehicle->parking_ID);
+    return parking_space != NULL && parking_space->status == OCCUPIED && parking_space->occupant == vehicle->plate;
+}
+
+// Makes room for one more resident vehicle, called with registry_lock held.
+// CLOCK sweep: a vehicle looked up since the hand last passed gets its referenced
+// bit cleared and is skipped. Unsaved, never saved and parked vehicles always stay.
+// An evicted vehicle is already on disk, so it is only unlinked. Its trie entry is pruned
+// if vehicles.idx covers its slot, otherwise the entry keeps the slot.
+void evict_cold_vehicles() {
+    int steps = 2 * resident_count;
+    while (resident_count >= MAX_RESIDENT_VEHICLES && steps-- > 0) {
+        struct vehicle_node* vehicle = *clock_hand;
+        if (vehicle == NULL) {
+            clock_hand = &vehicle_list;
+            continue;
+        }
+        if (vehicle->referenced) {
+            vehicle->referenced = 0;
+            clock_hand = &vehicle->next;
+            continue;
+        }
+        if (vehicle->dirty || vehicle->slot < 0 || vehicle_is_parked(vehicle)) {
+            clock_hand = &vehicle->next;
+            continue;
+        }
+
+        *clock_hand = vehicle->next;
+        set_slot_resident(vehicle->slot, 0);
+        struct trie_node* entry = find_indexed_plate(vehicle->plate);
+        if (entry != NULL && entry->vehicle == vehicle) {
+            if (vehicle->slot < index_slot_count) {
+                unindex_plate(vehicle->plate);
+            } else {
+                entry->vehicle = NULL;
+                entry->slot = vehicle->slot;
+            }
+        }
+        free_vehicle_node(vehicle);
+        resident_count--;
+    }
+}
+
+// Adds a vehicle at the head of the resident list, evicting first if the list is full
+void add_resident_vehicle(struct vehicle_node* vehicle) {
+    evict_cold_vehicles();
+    vehicle->next = vehicle_list;
+    vehicle_list = vehicle;
+    vehicle->referenced = 1;
+    resident_count++;
+}
+
+// Reads a cold vehicle back from its store slot, called with registry_lock held
+struct vehicle_node* load_cold_vehicle(int slot) {
+    struct vehicle_record record;
+    fseek(vehicle_store, (long)sizeof(struct store_header) + (long)slot * (long)sizeof(record), SEEK_SET);
+    if (fread(&record, sizeof(record), 1, vehicle_store) != 1) {
+        printf("Error: Unable to read vehicle record %d.\n", slot);
+        return NULL;
+    }
+
+    struct vehicle_node* vehicle = vehicle_from_record(&record, slot);
+    add_resident_vehicle(vehicle);
+    set_slot_resident(slot, 1);
+    claim_space(vehicle);
+    struct trie_node* entry = index_plate(vehicle->plate);
+    entry->vehicle = vehicle;
+    entry->slot = -1;
+    return vehicle;
+}
+
+// Function to check if a vehicle is already registered.
+// The trie answers for resident and recently stored plates, vehicles.idx for the rest;
+// a registered vehicle that is not in memory is read from vehicles.dat and becomes resident.
+struct vehicle_node* check_registered(uint64_t plate) {
+    struct trie_node* entry = find_indexed_plate(plate);
+    if (entry != NULL && entry->vehicle != NULL) {
+        entry->vehicle->referenced = 1;
+        return entry->vehicle;
+    }
+    if (entry != NULL && entry->slot >= 0) return load_cold_vehicle(entry->slot);
+
+    int slot = lookup_plate_index(plate);
+    return slot >= 0 ? load_cold_vehicle(slot) : NULL;
+}
+
+// Function to find a parking space in a lot based on membership
+struct parking_node* find_space_in_lot(struct parking_node* lot, int membership, const struct lot_policy* policy) {
+#if FIXED_LOT
+    if (lot == fixed_spaces) {
+        uint64_t candidates = free_space_mask & tier_space_mask[membership];
+        return candidates != 0 ? &fixed_spaces[__builtin_ctzll(candidates)] : NULL;
+    }
+#endif
+    struct parking_node* current = lot;
+    int space_number = 1;
+    
+    while (current != NULL) {
+        if (current->status == FREE) {
+            if ((membership == GOLD && space_number <= policy->gold_last_space) ||
+                (membership == PREMIUM && space_number > policy->gold_last_space &&
+                 space_number <= policy->premium_last_space) ||
+                (membership == NONE && space_number > policy->premium_last_space)) {
+                return current;
+            }
+        }
+        current = current->next;
+        space_number++;
+    }
+    return NULL;
+}
+
+// Function to find a space of a lot by its ID
+struct parking_node* space_in_lot(struct parking_node* lot, int id) {
+#if FIXED_LOT
+    if (lot == fixed_spaces) {
+        return id >= 1 && id <= MAX_PARKING_SPACES ? &fixed_spaces[id - 1] : NULL;
+    }
+#endif
+    for (struct parking_node* current = lot; current != NULL; current = current->next) {
+        if (current->parking_space_ID == id) {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+// Function to mark a space of a lot free or occupied
+void set_space_status(struct parking_node* lot, struct parking_node* space, int status) {
+    space->status = status;
+    space->dirty = 1;
+#if FIXED_LOT
+    if (lot == fixed_spaces) {
+        uint64_t bit = 1ULL << (space->parking_space_ID - 1);
+        free_space_mask = status == FREE ? free_space_mask | bit : free_space_mask & ~bit;
+    }
+#else
+    (void)lot;
+#endif
+}
+
+// Gate logic shared by the console and the simulator.
+// Records the arrival and takes a space for the vehicle, returns NULL if the lot has none.
+struct parking_node* admit_vehicle(struct parking_node* lot, const struct lot_policy* policy,
+                                   struct vehicle_node* vehicle, uint32_t arrival) {
+    vehicle->arrival = arrival;
+
+    struct parking_node* parking_space = find_space_in_lot(lot, vehicle->membership, policy);
+    if (parking_space != NULL) {
+        vehicle->parking_ID = parking_space->parking_space_ID;
+        set_space_status(lot, parking_space, OCCUPIED);
+        parking_space->occupant = vehicle->plate;
+        parking_space->occupancy_count++;
+    }
+    return parking_space;
+}
+
+// Bills a departing vehicle, frees its space and updates its membership. Returns the fee.
+int release_vehicle(struct parking_node* lot, const struct lot_policy* policy,
+                    struct vehicle_node* vehicle, uint32_t departure, int* parked_hours) {
+    *parked_hours = hours_parked(vehicle->arrival, departure);
+    vehicle->total_parking_hours += *parked_hours;
+
+    int fee = calculate_parking_fee(*parked_hours, vehicle->membership, policy);
+    vehicle->total_amount_paid += fee;
+    vehicle->parking_count++;
+
+    struct parking_node* parking_space = space_in_lot(lot, vehicle->parking_ID);
+    if (parking_space != NULL) {
+        set_space_status(lot, parking_space, FREE);
+        parking_space->occupant = 0;
+        parking_space->space_revenue += fee;
+    }
+    vehicle->parking_ID = 0;
+
+    // An exit only ever raises a membership; lowering one is left to re-tiering
+    int earned_membership = membership_for_hours(vehicle->total_parking_hours);
+    if (earned_membership > vehicle->membership) {
+        vehicle->membership = earned_membership;
+    }
+    return fee;
+}
+
+// Helper function to calculate parking fee
+int calculate_parking_fee(int hours_parked, int membership, const struct lot_policy* policy) {
+#if FIXED_LOT
+    if (policy == &gate_policy && hours_parked >= 0 && hours_parked < FIXED_FEE_HOURS) {
+        return fee_table[membership > 0][hours_parked];
+    }
+#endif
+    int fee = policy->base_fee;
+    if (hours_parked > policy->base_hours) {
+        fee += (hours_parked - policy->base_hours) * policy->extra_fee;
+    }
+    if (membership > 0) {
+        fee = (int)(fee * (1.0 - policy->discount));
+    }
+    return fee;
+}
+
+// Helper function to work out membership from accumulated hours
+// Function to load the thresholds saved by the last re-tiering pass
+void load_membership_tiers() {
+    FILE* file = fopen("membership_tiers.txt", "r");
+    if (!file) return;
+
+    int new_premium_hours, new_golden_hours;
+    if (fscanf(file, "%d %d", &new_premium_hours, &new_golden_hours) == 2 &&
+        new_premium_hours > 0 && new_golden_hours >= new_premium_hours) {
+        premium_hours = new_premium_hours;
+        golden_hours = new_golden_hours;
+        printf("Membership thresholds: premium %d hours, golden %d hours\n", premium_hours, golden_hours);
+    } else {
+        printf("Error: membership_tiers.txt is not valid, using the default thresholds.\n");
+    }
+    fclose(file);
+}
+
+// Function to save the current thresholds
+void save_membership_tiers() {
+    FILE* file = fopen("membership_tiers.txt", "w");
+    if (!file) {
+        printf("Error: Unable to save membership thresholds.\n");
+        return;
+    }
+    fprintf(file, "%d %d\n", premium_hours, golden_hours);
+    fclose(file);
+}
+
+int membership_for_hours(int total_hours) {
+    if (total_hours >= golden_hours) {
+        return GOLD;
+    } else if (total_hours >= premium_hours) {
+        return PREMIUM;
+    }
+    return NONE;
+}
+
+const char* membership_name(int membership) {
+    return membership == GOLD ? "GOLD" :
+           membership == PREMIUM ? "PREMIUM" : "NONE";
+}
+
+// Helper functions for date calculations
+int days_in_month(int month) {
+    int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return days[month - 1];
+}
+
+int totaldays(int date, int month, int year) {
+    int days = 0;
+    for (int i = 1990; i < year; i++) {
+        days += 365;
+    }
+    for (int i = 1; i < month; i++) {
+        days += days_in_month(i);
+    }
+    days += date;
+    return days;
+}
+
+// Converts an entered date and hour to minutes since 1990
+uint32_t datetime_to_minutes(struct datetime when) {
+    int days = totaldays(when.date, when.month, when.year);
+    return (uint32_t)(days * 24 + when.time) * 60;
+}
+
+int hours_parked(uint32_t arrival, uint32_t departure) {
+    int total_hours = (int)(((int64_t)departure - (int64_t)arrival) / 60);
+    if (total_hours < 0) {
+        total_hours += 24;
+    }
+    return total_hours;
+}
+
+// Parks a plate at the gate, registering it first if it is new. Called with the registry lock held.
+struct parking_node* park_plate(uint64_t plate, const char* owner_name, uint32_t arrival) {
+    struct vehicle_node* vehicle = check_registered(plate);
+    if (vehicle == NULL) {
+        vehicle = create_vehicle_node();
+        vehicle->plate = plate;
+        set_owner_name(vehicle, owner_name, (int)strlen(owner_name));
+        vehicle->membership = NONE;
+        vehicle->total_parking_hours = 0;
+        vehicle->total_amount_paid = 0;
+        vehicle->parking_count = 0;
+
+        add_resident_vehicle(vehicle);
+        vehicle_count++;
+        index_plate(plate)->vehicle = vehicle;
+    }
+
+    struct parking_node* parking_space = admit_vehicle(parking_list, &gate_policy, vehicle, arrival);
+    mark_vehicle_dirty(vehicle);
+    registry_version++;
+    return parking_space;
+}
+
+// Bills a plate leaving through the gate. Returns the vehicle, or NULL if the plate is not
+// registered. Called with the registry lock held.
+struct vehicle_node* exit_plate(uint64_t plate, uint32_t departure, int* fee, int* parked_hours) {
+    struct vehicle_node* vehicle = check_registered(plate);
+    if (vehicle == NULL) return NULL;
+
+    *fee = release_vehicle(parking_list, &gate_policy, vehicle, departure, parked_hours);
+    mark_vehicle_dirty(vehicle);
+    registry_version++;
+    return vehicle;
+}
+
+// Function to park a vehicle
+void park_vehicle() {
+    char vehicle_num[VEHICLE_NUM_SIZE], owner_name[OWNER_NAME_SIZE];
+    struct datetime arrival;
+    uint64_t plate;
+
+    printf("Enter vehicle number: ");
+    scanf("%12s", vehicle_num);
+    printf("Enter arrival time (24-hour format): ");
+    scanf("%d", &arrival.time);
+    printf("Enter arrival date: ");
+    scanf("%d", &arrival.date);
+    printf("Enter arrival month: ");
+    scanf("%d", &arrival.month);
+    printf("Enter arrival year: ");
+    scanf("%d", &arrival.year);
+
+    if (!encode_plate(vehicle_num, (int)strlen(vehicle_num), &plate)) {
+        printf("Invalid vehicle number, use letters and digits only.\n");
+        return;
+    }
+
+    lock_registry();
+    int registered = check_registered(plate) != NULL;
+    struct plate_matches matches;
+    matches.count = 0;
+    if (!registered) {
+        find_similar_plates(plate, PLATE_MATCH_DISTANCE, &matches);
+    }
+    unlock_registry();
+
+    // An unknown plate close to a registered one is most likely a camera misread
+    if (!registered && matches.count > 0) {
+        char match_text[VEHICLE_NUM_SIZE];
+        int choice;
+        printf("Vehicle %s is not registered. Similar registered vehicles:\n", vehicle_num);
+        for (int i = 0; i < matches.count; i++) {
+            decode_plate(matches.plates[i], match_text);
+            printf("%d. %s\n", i + 1, match_text);
+        }
+        printf("Enter the matching number, or 0 to register as a new vehicle: ");
+        if (scanf("%d", &choice) == 1 && choice >= 1 && choice <= matches.count) {
+            plate = matches.plates[choice - 1];
+            registered = 1;
+        }
+    }
+
+    owner_name[0] = '\0';
+    if (!registered) {
+        printf("Enter owner's name: ");
+        scanf("%19s", owner_name);
+    }
+
+    // park_plate() looks again under the lock, another gate may have registered the plate meanwhile
+    lock_registry();
+    struct parking_node* parking_space = park_plate(plate, owner_name, datetime_to_minutes(arrival));
+    int space_ID = parking_space != NULL ? parking_space->parking_space_ID : 0;
+    unlock_registry();
+
+    if (space_ID != 0) {
+        printf("Vehicle parked at space %d\n", space_ID);
+    } else {
+        printf("No suitable parking space available.\n");
+    }
+}
+
+// Function to handle vehicle exit
+void exit_vehicle() {
+    char vehicle_num[VEHICLE_NUM_SIZE];
+    struct datetime departure;
+    uint64_t plate;
+
+    printf("Enter vehicle number: ");
+    scanf("%12s", vehicle_num);
+    printf("Enter departure time (24-hour format): ");
+    scanf("%d", &departure.time);
+    printf("Enter departure date: ");
+    scanf("%d", &departure.date);
+    printf("Enter departure month: ");
+    scanf("%d", &departure.month);
+    printf("Enter departure year: ");
+    scanf("%d", &departure.year);
+
+    lock_registry();
+    struct vehicle_node* vehicle = NULL;
+    int fee, parked_hours;
+    if (encode_plate(vehicle_num, (int)strlen(vehicle_num), &plate)) {
+        vehicle = exit_plate(plate, datetime_to_minutes(departure), &fee, &parked_hours);
+    }
+    if (vehicle != NULL) {
+        int total_hours = vehicle->total_parking_hours;
+        int membership = vehicle->membership;
+        unlock_registry();
+
+        printf("\nVehicle Exit Summary:\n");
+        printf("Hours parked: %d\n", parked_hours);
+        printf("Parking fee: %d Rs\n", fee);
+        printf("Total parking hours: %d\n", total_hours);
+        printf("Membership status: %s\n", membership_name(membership));
+    } else {
+        unlock_registry();
+        printf("Vehicle not found in the system.\n");
+    }
+}
+
+// Function to look up plates by prefix and by similarity, for resolving misreads
+void search_plates() {
+    char text[VEHICLE_NUM_SIZE], match_text[VEHICLE_NUM_SIZE];
+    struct plate_matches prefix_matches, similar_matches;
+    uint64_t plate;
+
+    printf("Enter vehicle number or prefix: ");
+    scanf("%12s", text);
+    if (!encode_plate(text, (int)strlen(text), &plate)) {
+        printf("Invalid vehicle number, use letters and digits only.\n");
+        return;
+    }
+
+    lock_registry();
+    find_plates_by_prefix(text, &prefix_matches);
+    find_similar_plates(plate, PLATE_SEARCH_DISTANCE, &similar_matches);
+    unlock_registry();
+
+    printf("\nVehicles starting with %s:\n", text);
+    for (int i = 0; i < prefix_matches.count; i++) {
+        decode_plate(prefix_matches.plates[i], match_text);
+        printf("  %s\n", match_text);
+    }
+    if (prefix_matches.count == 0) printf("  none\n");
+
+    printf("Vehicles within %d edits of %s:\n", PLATE_SEARCH_DISTANCE, text);
+    for (int i = 0; i < similar_matches.count; i++) {
+        decode_plate(similar_matches.plates[i], match_text);
+        printf("  %-13s (%d)\n", match_text, similar_matches.distances[i]);
+    }
+    if (similar_matches.count == 0) printf("  none\n");
+    if (prefix_matches.count == MAX_PLATE_MATCHES || similar_matches.count == MAX_PLATE_MATCHES) {
+        printf("Only the first %d matches of each kind are shown.\n", MAX_PLATE_MATCHES);
+    }
+}
+
+// Structure for one contiguous chunk of the vehicle list in the re-tiering pass
+struct retier_chunk {
+    struct vehicle_node* start;
+    int length;
+    struct tier_change* changes;
+    struct tier_change* changes_tail;
+};
+
+// Works out new memberships for one chunk without touching the vehicles
+void* retier_chunk_worker(void* arg) {
+    struct retier_chunk* chunk = (struct retier_chunk*)arg;
+    struct vehicle_node* current = chunk->start;
+
+    for (int i = 0; i < chunk->length && current != NULL; i++) {
+        int new_membership = membership_for_hours(current->total_parking_hours);
+        if (new_membership != current->membership) {
+            struct tier_change* change = (struct tier_change*)malloc(sizeof(struct tier_change));
+            if (change == NULL) {
+                printf("Memory allocation failed!\n");
+                exit(1);
+            }
+            change->vehicle = current;
+            change->slot = current->slot;
+            change->plate = current->plate;
+            change->old_membership = current->membership;
+            change->new_membership = new_membership;
+            change->next = NULL;
+
+            if (chunk->changes == NULL) {
+                chunk->changes = chunk->changes_tail = change;
+            } else {
+                chunk->changes_tail->next = change;
+                chunk->changes_tail = change;
+            }
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+// Queues a membership change for a vehicle that is only in vehicles.dat
+void retier_cold_record(const struct vehicle_record* record, int slot, void* context) {
+    struct retier_chunk* cold = (struct retier_chunk*)context;
+    int new_membership = membership_for_hours(record->total_parking_hours);
+    if (new_membership == record_membership(record)) return;
+
+    struct tier_change* change = (struct tier_change*)malloc(sizeof(struct tier_change));
+    if (change == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    change->vehicle = NULL;
+    change->slot = slot;
+    change->plate = record->plate;
+    change->old_membership = record_membership(record);
+    change->new_membership = new_membership;
+    change->next = NULL;
+
+    if (cold->changes == NULL) {
+        cold->changes = cold->changes_tail = change;
+    } else {
+        cold->changes_tail->next = change;
+        cold->changes_tail = change;
+    }
+}
+
+// Recomputes every vehicle's membership and returns the list of changes, applied in one batch.
+// Resident vehicles are split into chunks for the workers. Cold ones are read from the store
+// afterwards without registry_lock, so gates keep working, and only their membership byte is rewritten.
+struct tier_change* retier_all(int new_premium_hours, int new_golden_hours) {
+    lock_registry();
+    premium_hours = new_premium_hours;
+    golden_hours = new_golden_hours;
+    save_membership_tiers();
+
+    int chunk_count = 1;
+    if (PARKING_THREADS && resident_count >= 2 * RETIER_CHUNK_SIZE) {
+        chunk_count = WORKER_THREADS;
+    }
+    int chunk_size = (resident_count + chunk_count - 1) / chunk_count;
+
+    struct retier_chunk chunks[WORKER_THREADS];
+    struct vehicle_node* current = vehicle_list;
+    for (int c = 0; c < chunk_count; c++) {
+        chunks[c].start = current;
+        chunks[c].length = chunk_size;
+        chunks[c].changes = NULL;
+        chunks[c].changes_tail = NULL;
+        for (int i = 0; i < chunk_size && current != NULL; i++) {
+            current = current->next;
+        }
+    }
+
+#if PARKING_THREADS
+    pthread_t threads[WORKER_THREADS];
+    for (int c = 1; c < chunk_count; c++) {
+        if (pthread_create(&threads[c], NULL, retier_chunk_worker, &chunks[c]) != 0) {
+            printf("Unable to start worker thread!\n");
+            exit(1);
+        }
+    }
+    retier_chunk_worker(&chunks[0]);
+    for (int c = 1; c < chunk_count; c++) {
+        pthread_join(threads[c], NULL);
+    }
+#else
+    for (int c = 0; c < chunk_count; c++) {
+        retier_chunk_worker(&chunks[c]);
+    }
+#endif
+
+    // Join the per-chunk deltas in list order and apply them together
+    struct tier_change* delta = NULL;
+    struct tier_change* tail = NULL;
+    for (int c = 0; c < chunk_count; c++) {
+        if (chunks[c].changes == NULL) continue;
+        if (delta == NULL) {
+            delta = chunks[c].changes;
+        } else {
+            tail->next = chunks[c].changes;
+        }
+        tail = chunks[c].changes_tail;
+    }
+
+    for (struct tier_change* change = delta; change != NULL; change = change->next) {
+        change->vehicle->membership = change->new_membership;
+        mark_vehicle_dirty(change->vehicle);
+    }
+    struct cold_scan scan;
+    begin_cold_scan(&scan);
+    registry_version++;
+    unlock_registry();
+
+    struct retier_chunk cold;
+    cold.changes = NULL;
+    cold.changes_tail = NULL;
+    if (scan.slot_count > 0) {
+        FILE* store = fopen("vehicles.dat", "rb");
+        if (store == NULL) {
+            printf("Error: Unable to read vehicles.dat, stored vehicles were not re-tiered.\n");
+        } else {
+            scan_store_records(store, &scan, retier_cold_record, &cold);
+            fclose(store);
+        }
+    }
+
+    lock_registry();
+    end_cold_scan(&scan);
+#if PARKING_THREADS
+    // Cold membership bytes are rewritten in place, wait for snapshots still reading them
+    while (active_cold_scans != NULL) {
+        pthread_cond_wait(&cold_scans_done, &registry_lock);
+    }
+#endif
+    for (struct tier_change* change = cold.changes; change != NULL; change = change->next) {
+        struct trie_node* entry = slot_is_resident(change->slot) ? find_indexed_plate(change->plate) : NULL;
+        if (entry != NULL && entry->vehicle != NULL) {
+            // A gate read the vehicle back during the scan, its hours may have changed since
+            entry->vehicle->membership = membership_for_hours(entry->vehicle->total_parking_hours);
+            mark_vehicle_dirty(entry->vehicle);
+        } else {
+            uint8_t membership = (uint8_t)change->new_membership;
+            long position = (long)sizeof(struct store_header) + (long)change->slot * (long)sizeof(struct vehicle_record);
+            fseek(vehicle_store, position + (long)offsetof(struct vehicle_record, membership), SEEK_SET);
+            fwrite(&membership, sizeof(membership), 1, vehicle_store);
+        }
+    }
+    if (cold.changes != NULL) {
+        fflush(vehicle_store);
+        registry_version++;
+    }
+    unlock_registry();
+
+    if (delta == NULL) {
+        delta = cold.changes;
+    } else {
+        tail->next = cold.changes;
+    }
+    return delta;
+}
+
+// Function to re-evaluate all memberships against new thresholds
+void retier_vehicles() {
+    int new_premium_hours, new_golden_hours;
+
+    printf("Enter premium threshold hours (current %d): ", premium_hours);
+    if (scanf("%d", &new_premium_hours) != 1) {
+        printf("Invalid input!\n");
+        while (getchar() != '\n');
+        return;
+    }
+    printf("Enter golden threshold hours (current %d): ", golden_hours);
+    if (scanf("%d", &new_golden_hours) != 1) {
+        printf("Invalid input!\n");
+        while (getchar() != '\n');
+        return;
+    }
+    if (new_premium_hours <= 0 || new_golden_hours < new_premium_hours) {
+        printf("Golden threshold must be at least the premium threshold, and both positive.\n");
+        return;
+    }
+
+    struct tier_change* delta = retier_all(new_premium_hours, new_golden_hours);
+
+    printf("\nMembership changes:\n");
+    printf("Vehicle Number | Old      | New\n");
+    printf("--------------------------------\n");
+
+    int changed = 0;
+    int showing = 1;
+    char plate_text[VEHICLE_NUM_SIZE];
+    while (delta != NULL) {
+        struct tier_change* temp = delta;
+        if (showing) {
+            decode_plate(delta->plate, plate_text);
+            printf("%-13s | %-8s | %s\n", plate_text,
+                   membership_name(delta->old_membership),
+                   membership_name(delta->new_membership));
+            if ((changed + 1) % REPORT_PAGE_SIZE == 0 && delta->next != NULL) {
+                showing = next_page_wanted();
+            }
+        }
+        changed++;
+        delta = delta->next;
+        free(temp);
+    }
+
+    printf("--------------------------------\n");
+    printf("%d of %d vehicles changed membership.\n", changed, vehicle_count);
+}
+
+// Sort keys. Each compare function returns a negative number if a comes before b,
+// ties fall through to the next key so every report has a fixed order.
+typedef int (*vehicle_compare)(const struct vehicle_node* a, const struct vehicle_node* b);
+typedef int (*parking_compare)(const struct parking_node* a, const struct parking_node* b);
+
+int compare_plates(const struct vehicle_node* a, const struct vehicle_node* b) {
+    return (a->plate > b->plate) - (a->plate < b->plate);
+}
+
+// Parkings descending, then vehicle number ascending
+int compare_by_parkings(const struct vehicle_node* a, const struct vehicle_node* b) {
+    if (a->parking_count != b->parking_count) {
+        return a->parking_count > b->parking_count ? -1 : 1;
+    }
+    return compare_plates(a, b);
+}
+
+// Amount paid descending, then vehicle number ascending
+int compare_by_amount(const struct vehicle_node* a, const struct vehicle_node* b) {
+    if (a->total_amount_paid != b->total_amount_paid) {
+        return a->total_amount_paid > b->total_amount_paid ? -1 : 1;
+    }
+    return compare_plates(a, b);
+}
+
+// Times occupied descending, then space ID ascending
+int compare_by_occupancy(const struct parking_node* a, const struct parking_node* b) {
+    if (a->occupancy_count != b->occupancy_count) {
+        return a->occupancy_count > b->occupancy_count ? -1 : 1;
+    }
+    return a->parking_space_ID - b->parking_space_ID;
+}
+
+// Revenue descending, then times occupied descending, then space ID ascending
+int compare_by_revenue(const struct parking_node* a, const struct parking_node* b) {
+    if (a->space_revenue != b->space_revenue) {
+        return a->space_revenue > b->space_revenue ? -1 : 1;
+    }
+    return compare_by_occupancy(a, b);
+}
+
+// Merge functions for sorting. Equal keys keep head1 first, so the sorts are stable.
+struct vehicle_node* merge_vehicles(struct vehicle_node* head1, struct vehicle_node* head2,
+                                    vehicle_compare compare) {
+    struct vehicle_node* result = NULL;
+    struct vehicle_node* tail = NULL;
+
+    while (head1 != NULL && head2 != NULL) {
+        if (compare(head1, head2) <= 0) {
+            if (result == NULL) {
+                result = tail = head1;
+            } else {
+                tail->next = head1;
+                tail = head1;
+            }
+            head1 = head1->next;
+        } else {
+            if (result == NULL) {
+                result = tail = head2;
+            } else {
+                tail->next = head2;
+                tail = head2;
+            }
+            head2 = head2->next;
+        }
+    }
+
+    if (head1 != NULL) {
+        if (result == NULL) result = head1;
+        else tail->next = head1;
+    }
+    if (head2 != NULL) {
+        if (result == NULL) result = head2;
+        else tail->next = head2;
+    }
+
+    return result;
+}
+
+struct parking_node* merge_parking(struct parking_node* head1, struct parking_node* head2,
+                                   parking_compare compare) {
+    struct parking_node* result = NULL;
+    struct parking_node* tail = NULL;
+
+    while (head1 != NULL && head2 != NULL) {
+        if (compare(head1, head2) <= 0) {
+            if (result == NULL) {
+                result = tail = head1;
+            } else {
+                tail->next = head1;
+                tail = head1;
+            }
+            head1 = head1->next;
+        } else {
+            if (result == NULL) {
+                result = tail = head2;
+            } else {
+                tail->next = head2;
+                tail = head2;
+            }
+            head2 = head2->next;
+        }
+    }
+
+    if (head1 != NULL) {
+        if (result == NULL) result = head1;
+        else tail->next = head1;
+    }
+    if (head2 != NULL) {
+        if (result == NULL) result = head2;
+        else tail->next = head2;
+    }
+
+    return result;
+}
+
+// Generic divide function
+struct vehicle_node* divide(struct vehicle_node* head) {
+    struct vehicle_node* fast = head;
+    struct vehicle_node* slow = head;
+    struct vehicle_node* prev = NULL;
+    
+    while (fast != NULL && fast->next != NULL) {
+        fast = fast->next->next;
+        prev = slow;
+        slow = slow->next;
+    }
+    
+    if (prev != NULL) {
+        prev->next = NULL;
+    }
+    
+    return slow;
+}
+
+struct parking_node* divide_parking(struct parking_node* head) {
+    struct parking_node* fast = head;
+    struct parking_node* slow = head;
+    struct parking_node* prev = NULL;
+    
+    while (fast != NULL && fast->next != NULL) {
+        fast = fast->next->next;
+        prev = slow;
+        slow = slow->next;
+    }
+    
+    if (prev != NULL) {
+        prev->next = NULL;
+    }
+    
+    return slow;
+}
+
+// Merge sort functions
+struct vehicle_node* mergeSort_vehicles(struct vehicle_node* head, vehicle_compare compare) {
+    if (head == NULL || head->next == NULL) return head;
+
+    struct vehicle_node* middle = divide(head);
+    struct vehicle_node* left = mergeSort_vehicles(head, compare);
+    struct vehicle_node* right = mergeSort_vehicles(middle, compare);
+
+    return merge_vehicles(left, right, compare);
+}
+
+struct parking_node* mergeSort_parking(struct parking_node* head, parking_compare compare) {
+    if (head == NULL || head->next == NULL) return head;
+
+    struct parking_node* middle = divide_parking(head);
+    struct parking_node* left = mergeSort_parking(head, compare);
+    struct parking_node* right = mergeSort_parking(middle, compare);
+
+    return merge_parking(left, right, compare);
+}
+
+// Structure for one worker's share of a parallel sort: sort run, or merge run with other
+struct sort_task {
+    struct vehicle_node* run;
+    struct vehicle_node* other;
+    vehicle_compare compare;
+};
+
+void* sort_task_worker(void* arg) {
+    struct sort_task* task = (struct sort_task*)arg;
+    if (task->other == NULL) {
+        task->run = mergeSort_vehicles(task->run, task->compare);
+    } else {
+        task->run = merge_vehicles(task->run, task->other, task->compare);
+        task->other = NULL;
+    }
+    return NULL;
+}
+
+// Runs one task per slot, on worker threads when they are available
+void run_sort_tasks(struct sort_task tasks[], int task_count) {
+#if PARKING_THREADS
+    pthread_t threads[WORKER_THREADS];
+    for (int t = 1; t < task_count; t++) {
+        if (pthread_create(&threads[t], NULL, sort_task_worker, &tasks[t]) != 0) {
+            printf("Unable to start worker thread!\n");
+            exit(1);
+        }
+    }
+    sort_task_worker(&tasks[0]);
+    for (int t = 1; t < task_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+#else
+    for (int t = 0; t < task_count; t++) {
+        sort_task_worker(&tasks[t]);
+    }
+#endif
+}
+
+// Sorts a vehicle list. Large lists are cut into contiguous runs that are sorted
+// on worker threads, then neighbouring runs are merged pairwise, also in parallel.
+// Runs stay in list order and merges keep the left run first on ties, so the result is stable.
+struct vehicle_node* sort_vehicles(struct vehicle_node* head, vehicle_compare compare) {
+    int length = 0;
+    for (struct vehicle_node* current = head; current != NULL; current = current->next) {
+        length++;
+    }
+    if (!PARKING_THREADS || length < PARALLEL_SORT_MIN) {
+        return mergeSort_vehicles(head, compare);
+    }
+
+    struct sort_task tasks[WORKER_THREADS];
+    int run_length = (length + WORKER_THREADS - 1) / WORKER_THREADS;
+    int run_count = 0;
+    struct vehicle_node* current = head;
+    while (current != NULL) {
+        tasks[run_count].run = current;
+        tasks[run_count].other = NULL;
+        tasks[run_count].compare = compare;
+        for (int i = 1; i < run_length && current->next != NULL; i++) {
+            current = current->next;
+        }
+        struct vehicle_node* next = current->next;
+        current->next = NULL;
+        current = next;
+        run_count++;
+    }
+    run_sort_tasks(tasks, run_count);
+
+    while (run_count > 1) {
+        int merged_count = 0;
+        for (int r = 0; r < run_count; r += 2) {
+            tasks[merged_count].run = tasks[r].run;
+            tasks[merged_count].other = r + 1 < run_count ? tasks[r + 1].run : NULL;
+            tasks[merged_count].compare = compare;
+            merged_count++;
+        }
+        // A leftover odd run has nothing to merge with and is already sorted
+        if (run_count % 2 == 1) {
+            merged_count--;
+            run_sort_tasks(tasks, merged_count);
+            merged_count++;
+        } else {
+            run_sort_tasks(tasks, merged_count);
+        }
+        run_count = merged_count;
+    }
+    return tasks[0].run;
+}
+
+// Copies the live lists into a new snapshot, called with registry_lock held. Parking
+// reports pass with_vehicles 0 and get the spaces only. Otherwise the resident vehicles
+// are copied and the slots of the cold ones are recorded in the snapshot's scan.
+struct registry_snapshot* capture_snapshot(int with_vehicles) {
+    struct registry_snapshot* snapshot = (struct registry_snapshot*)malloc(sizeof(struct registry_snapshot));
+    int space_count = 0;
+    for (struct parking_node* current = parking_list; current != NULL; current = current->next) {
+        space_count++;
+    }
+
+    int resident = with_vehicles ? resident_count : 0;
+    struct vehicle_node* vehicles = NULL;
+    struct parking_node* spaces = NULL;
+    if (resident > 0) {
+        vehicles = (struct vehicle_node*)malloc(resident * sizeof(struct vehicle_node));
+    }
+    if (space_count > 0) {
+        spaces = (struct parking_node*)malloc(space_count * sizeof(struct parking_node));
+    }
+    if (snapshot == NULL || (resident > 0 && vehicles == NULL) || (space_count > 0 && spaces == NULL)) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+
+    int i = 0;
+    for (struct vehicle_node* current = vehicle_list; current != NULL && i < resident; current = current->next, i++) {
+        vehicles[i] = *current;
+        vehicles[i].next = i + 1 < resident ? &vehicles[i + 1] : NULL;
+    }
+    snapshot->vehicle_count = with_vehicles ? vehicle_count : 0;
+    snapshot->resident_count = i;
+    snapshot->vehicles = i > 0 ? vehicles : NULL;
+    if (with_vehicles) {
+        begin_cold_scan(&snapshot->scan);
+    } else {
+        snapshot->scan.slot_count = 0;
+        snapshot->scan.resident = NULL;
+        snapshot->scan.resident_size = 0;
+    }
+
+    i = 0;
+    for (struct parking_node* current = parking_list; current != NULL; current = current->next, i++) {
+        spaces[i] = *current;
+        spaces[i].next = i + 1 < space_count ? &spaces[i + 1] : NULL;
+    }
+
+    snapshot->version = registry_version;
+    snapshot->refcount = 1;
+    snapshot->spaces = spaces;
+    return snapshot;
+}
+
+void free_snapshot(struct registry_snapshot* snapshot) {
+    free(snapshot->vehicles);
+    free(snapshot->spaces);
+    free(snapshot);
+}
+
+// Returns a consistent view of the registry for a reader. The lock is held only while
+// the resident lists are copied, which happens only if a gate write came in since the last
+// cached snapshot; otherwise that one is shared. Cold vehicles are never copied, so the
+// lock is not held while vehicles.dat is read.
+struct registry_snapshot* acquire_snapshot(int with_vehicles) {
+    lock_registry();
+    if (current_snapshot != NULL && current_snapshot->version == registry_version) {
+        struct registry_snapshot* snapshot = current_snapshot;
+        snapshot->refcount++;
+        unlock_registry();
+        return snapshot;
+    }
+    struct registry_snapshot* snapshot = capture_snapshot(with_vehicles);
+    if (with_vehicles && snapshot->scan.slot_count == 0) {
+        struct registry_snapshot* old_snapshot = current_snapshot;
+        current_snapshot = snapshot;
+        snapshot->refcount++;
+        if (old_snapshot != NULL && --old_snapshot->refcount == 0) {
+            free_snapshot(old_snapshot);
+        }
+    }
+    unlock_registry();
+    return snapshot;
+}
+
+// Drops a reader's reference; the last one ends the snapshot's cold scan, so checkpoints
+// can write the records it was holding back, and frees the copy
+void release_snapshot(struct registry_snapshot* snapshot) {
+    lock_registry();
+    int unused = --snapshot->refcount == 0;
+    if (unused) {
+        end_cold_scan(&snapshot->scan);
+    }
+    unlock_registry();
+    if (unused) {
+        free_snapshot(snapshot);
+    }
+}
+
+// Structure describing a vehicle report: its sort order and the value it shows
+struct vehicle_report {
+    const char* title;
+    const char* value_header;
+    vehicle_compare compare;
+    int (*value)(const struct vehicle_node* v);
+};
+
+// Structure describing a parking space report
+struct parking_report {
+    const char* title;
+    const char* value_header;
+    parking_compare compare;
+    int (*value)(const struct parking_node* p);
+};
+
+int parking_count_value(const struct vehicle_node* v) { return v->parking_count; }
+int amount_paid_value(const struct vehicle_node* v) { return v->total_amount_paid; }
+int occupancy_value(const struct parking_node* p) { return p->occupancy_count; }
+int revenue_value(const struct parking_node* p) { return p->space_revenue; }
+
+const struct vehicle_report parkings_report = {
+    "Vehicles sorted by total parkings", "Total Parkings", compare_by_parkings, parking_count_value
+};
+const struct vehicle_report amount_report = {
+    "Vehicles sorted by total amount paid", "Amount Paid (Rs)", compare_by_amount, amount_paid_value
+};
+const struct parking_report occupancy_report = {
+    "Parking spaces sorted by occupancy", "Times Occupied", compare_by_occupancy, occupancy_value
+};
+const struct parking_report revenue_report = {
+    "Parking spaces sorted by revenue", "Revenue (Rs)", compare_by_revenue, revenue_value
+};
+
+// Structure for a report query: which rows to return and how to write them.
+// membership is -1 for any tier, max_value is -1 for no upper bound, limit is 0 for all rows.
+struct report_query {
+    int membership;
+    int min_value;
+    int max_value;
+    int offset;
+    int limit;
+    int format;
+    FILE* out;
+};
+
+// Works out which membership a space is reserved for at the gates, matching find_space_in_lot
+int space_membership(int parking_space_ID) {
+    if (parking_space_ID <= GOLD_LAST_SPACE) return GOLD;
+    if (parking_space_ID <= PREMIUM_LAST_SPACE) return PREMIUM;
+    return NONE;
+}
+
+int value_in_range(int value, const struct report_query* query) {
+    return value >= query->min_value && (query->max_value < 0 || value <= query->max_value);
+}
+
+// Binary heap helpers for top-N selection. The root is the row that sorts last,
+// so it is the one replaced when a better row turns up.
+void sift_up_vehicles(struct vehicle_node** heap, int index, vehicle_compare compare) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (compare(heap[index], heap[parent]) <= 0) break;
+        struct vehicle_node* temp = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = temp;
+        index = parent;
+    }
+}
+
+void sift_down_vehicles(struct vehicle_node** heap, int size, int index, vehicle_compare compare) {
+    while (1) {
+        int worst = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < size && compare(heap[left], heap[worst]) > 0) worst = left;
+        if (right < size && compare(heap[right], heap[worst]) > 0) worst = right;
+        if (worst == index) break;
+        struct vehicle_node* temp = heap[index];
+        heap[index] = heap[worst];
+        heap[worst] = temp;
+        index = worst;
+    }
+}
+
+// Report rows are plain heap copies that carry their owner name after the node, so a row
+// can outlive the store record it came from. Readers must not take nodes from the registry's blocks.
+struct vehicle_node* copy_vehicle_node(const struct vehicle_node* source) {
+#if FIXED_LOT
+    size_t name_size = 0;
+#else
+    size_t name_size = strlen(source->owner_name) + 1;
+#endif
+    struct vehicle_node* new_node = (struct vehicle_node*)malloc(sizeof(struct vehicle_node) + name_size);
+    if (new_node == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    *new_node = *source;
+    new_node->next = NULL;
+#if !FIXED_LOT
+    new_node->owner_name = (const char*)memcpy(new_node + 1, source->owner_name, name_size);
+#endif
+    return new_node;
+}
+
+// Structure for choosing report rows from vehicles offered one at a time
+struct row_selection {
+    const struct vehicle_report* report;
+    const struct report_query* query;
+    struct vehicle_node** heap;
+    int wanted;
+    int heap_size;
+    int matched;
+    struct vehicle_node* rows;
+};
+
+// Function to offer one vehicle to a selection. Only rows that are kept get copied,
+// so the vehicle can be a temporary built from a store record.
+void offer_vehicle_row(struct row_selection* selection, const struct vehicle_node* vehicle) {
+    const struct report_query* query = selection->query;
+    vehicle_compare compare = selection->report->compare;
+    if (query->membership >= 0 && vehicle->membership != query->membership) return;
+    if (!value_in_range(selection->report->value(vehicle), query)) return;
+    selection->matched++;
+
+    if (selection->wanted == 0) {
+        struct vehicle_node* row = copy_vehicle_node(vehicle);
+        row->next = selection->rows;
+        selection->rows = row;
+    } else if (selection->heap_size < selection->wanted) {
+        selection->heap[selection->heap_size] = copy_vehicle_node(vehicle);
+        sift_up_vehicles(selection->heap, selection->heap_size, compare);
+        selection->heap_size++;
+    } else if (compare(vehicle, selection->heap[0]) < 0) {
+        free(selection->heap[0]);
+        selection->heap[0] = copy_vehicle_node(vehicle);
+        sift_down_vehicles(selection->heap, selection->heap_size, 0, compare);
+    }
+}
+
+void offer_cold_row(const struct vehicle_record* record, int slot, void* context) {
+    struct vehicle_node vehicle;
+    memset(&vehicle, 0, sizeof(vehicle));
+#if FIXED_LOT
+    char* owner_name = vehicle.owner_name;
+#else
+    char owner_name[OWNER_NAME_SIZE];
+    vehicle.owner_name = owner_name;
+#endif
+    int length = (int)strnlen(record->owner_name, OWNER_NAME_SIZE - 1);
+    memcpy(owner_name, record->owner_name, length);
+    owner_name[length] = '\0';
+
+    vehicle.plate = record->plate;
+    vehicle.arrival = record->arrival;
+    vehicle.total_parking_hours = record->total_parking_hours;
+    vehicle.total_amount_paid = record->total_amount_paid;
+    vehicle.parking_count = record->parking_count;
+    vehicle.parking_ID = record->parking_ID;
+    vehicle.membership = record_membership(record);
+    vehicle.slot = slot;
+    offer_vehicle_row((struct row_selection*)context, &vehicle);
+}
+
+// Returns a sorted copy of the rows the query asks for and sets matched to the number
+// of rows passing the filters. With a limit only the best offset + limit rows are kept
+// while scanning, so a page or top-N query never sorts the whole registry. The heap
+// never holds more rows than the snapshot has, whatever limit was asked for. Cold
+// vehicles are streamed from vehicles.dat through the heap without registry_lock;
+// the snapshot's scan keeps checkpoints off those records meanwhile.
+struct vehicle_node* select_vehicle_rows(struct registry_snapshot* snapshot, const struct vehicle_report* report,
+                                         const struct report_query* query, int* matched) {
+    struct row_selection selection;
+    selection.report = report;
+    selection.query = query;
+    selection.heap = NULL;
+    selection.wanted = 0;
+    selection.heap_size = 0;
+    selection.matched = 0;
+    selection.rows = NULL;
+
+    if (query->limit > 0) {
+        long long rows_needed = (long long)query->offset + query->limit;
+        selection.wanted = rows_needed < snapshot->vehicle_count ? (int)rows_needed : snapshot->vehicle_count;
+    }
+    if (selection.wanted > 0) {
+        selection.heap = (struct vehicle_node**)malloc((size_t)selection.wanted * sizeof(struct vehicle_node*));
+        if (selection.heap == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(1);
+        }
+    }
+
+    for (struct vehicle_node* current = snapshot->vehicles; current != NULL; current = current->next) {
+        offer_vehicle_row(&selection, current);
+    }
+    if (snapshot->scan.slot_count > 0) {
+        FILE* store = fopen("vehicles.dat", "rb");
+        if (store == NULL) {
+            printf("Error: Unable to read vehicles.dat, the report only covers vehicles in memory.\n");
+        } else {
+            scan_store_records(store, &snapshot->scan, offer_cold_row, &selection);
+            fclose(store);
+        }
+    }
+
+    struct vehicle_node* rows = selection.rows;
+    for (int i = 0; i < selection.heap_size; i++) {
+        selection.heap[i]->next = rows;
+        rows = selection.heap[i];
+    }
+    free(selection.heap);
+    *matched = selection.matched;
+
+    rows = sort_vehicles(rows, report->compare);
+    for (int i = 0; i < query->offset && rows != NULL; i++) {
+        struct vehicle_node* temp = rows;
+        rows = rows->next;
+        free(temp);
+    }
+    return rows;
+}
+
+// Returns a sorted copy of the parking rows the query asks for. The parking list is
+// bounded by the lot size, so it is filtered and sorted in full.
+struct parking_node* select_parking_rows(struct parking_node* head, const struct parking_report* report,
+                                         const struct report_query* query, int* matched) {
+    struct parking_node* rows = NULL;
+
+    *matched = 0;
+    for (struct parking_node* current = head; current != NULL; current = current->next) {
+        if (query->membership >= 0 && space_membership(current->parking_space_ID) != query->membership) continue;
+        if (!value_in_range(report->value(current), query)) continue;
+        (*matched)++;
+
+        struct parking_node* row = create_parking_node(current->parking_space_ID);
+        row->status = current->status;
+        row->occupancy_count = current->occupancy_count;
+        row->space_revenue = current->space_revenue;
+        row->next = rows;
+        rows = row;
+    }
+
+    rows = mergeSort_parking(rows, report->compare);
+    for (int i = 0; i < query->offset && rows != NULL; i++) {
+        struct parking_node* temp = rows;
+        rows = rows->next;
+        free(temp);
+    }
+
+    // Drop anything past the limit
+    if (query->limit > 0) {
+        struct parking_node* current = rows;
+        for (int i = 1; i < query->limit && current != NULL; i++) {
+            current = current->next;
+        }
+        if (current != NULL) {
+            struct parking_node* extra = current->next;
+            current->next = NULL;
+            while (extra != NULL) {
+                struct parking_node* temp = extra;
+                extra = extra->next;
+                free(temp);
+            }
+        }
+    }
+    return rows;
+}
+
+// Fixed-size records written by binary report exports, in host byte order
+struct vehicle_report_record {
+    uint64_t plate;
+    int32_t membership;
+    int32_t parking_count;
+    int32_t total_amount_paid;
+    int32_t total_parking_hours;
+};
+
+struct parking_report_record {
+    int32_t parking_space_ID;
+    int32_t status;
+    int32_t occupancy_count;
+    int32_t space_revenue;
+};
+
+// Writes report rows in the query's format and frees them, returns the number written
+int write_vehicle_rows(struct vehicle_node* rows, const struct vehicle_report* report,
+                       const struct report_query* query) {
+    char plate_text[VEHICLE_NUM_SIZE];
+    int written = 0;
+
+    if (query->format == REPORT_CSV) {
+        fprintf(query->out, "vehicle_num,owner_name,membership,parking_count,total_amount_paid,total_parking_hours\n");
+    }
+    while (rows != NULL) {
+        if (query->format == REPORT_BINARY) {
+            struct vehicle_report_record record;
+            record.plate = rows->plate;
+            record.membership = rows->membership;
+            record.parking_count = rows->parking_count;
+            record.total_amount_paid = rows->total_amount_paid;
+            record.total_parking_hours = rows->total_parking_hours;
+            fwrite(&record, sizeof(record), 1, query->out);
+        } else {
+            decode_plate(rows->plate, plate_text);
+            if (query->format == REPORT_CSV) {
+                fprintf(query->out, "%s,%s,%s,%d,%d,%d\n", plate_text, rows->owner_name,
+                        membership_name(rows->membership), rows->parking_count,
+                        rows->total_amount_paid, rows->total_parking_hours);
+            } else {
+                fprintf(query->out, "%-13s | %d\n", plate_text, report->value(rows));
+            }
+        }
+        written++;
+
+        struct vehicle_node* temp = rows;
+        rows = rows->next;
+        free(temp);
+    }
+    return written;
+}
+
+int write_parking_rows(struct parking_node* rows, const struct parking_report* report,
+                       const struct report_query* query) {
+    int written = 0;
+
+    if (query->format == REPORT_CSV) {
+        fprintf(query->out, "parking_space_ID,status,occupancy_count,space_revenue\n");
+    }
+    while (rows != NULL) {
+        if (query->format == REPORT_BINARY) {
+            struct parking_report_record record;
+            record.parking_space_ID = rows->parking_space_ID;
+            record.status = rows->status;
+            record.occupancy_count = rows->occupancy_count;
+            record.space_revenue = rows->space_revenue;
+            fwrite(&record, sizeof(record), 1, query->out);
+        } else if (query->format == REPORT_CSV) {
+            fprintf(query->out, "%d,%s,%d,%d\n", rows->parking_space_ID,
+                    rows->status == OCCUPIED ? "OCCUPIED" : "FREE",
+                    rows->occupancy_count, rows->space_revenue);
+        } else {
+            fprintf(query->out, "%-8d | %d\n", rows->parking_space_ID, report->value(rows));
+        }
+        written++;
+
+        struct parking_node* temp = rows;
+        rows = rows->next;
+        free(temp);
+    }
+    return written;
+}
+
+// Asks whether to print another page, returns 1 for yes
+int next_page_wanted() {
+    char answer;
+    printf("-- Show more? (y/n): ");
+    if (scanf(" %c", &answer) != 1) return 0;
+    return answer == 'y' || answer == 'Y';
+}
+
+// Prints a vehicle report to the console one page at a time
+void display_vehicle_report(struct registry_snapshot* snapshot, const struct vehicle_report* report) {
+    struct report_query query = { -1, 0, -1, 0, REPORT_PAGE_SIZE, REPORT_TEXT, stdout };
+    int matched;
+
+    printf("\n%s:\n", report->title);
+    printf("Vehicle Number | %s\n", report->value_header);
+    printf("--------------------------------\n");
+
+    do {
+        struct vehicle_node* rows = select_vehicle_rows(snapshot, report, &query, &matched);
+        query.offset += write_vehicle_rows(rows, report, &query);
+    } while (query.offset < matched && next_page_wanted());
+
+    printf("--------------------------------\n");
+    printf("Showing %d of %d vehicles\n", query.offset, matched);
+}
+
+// Prints a parking space report to the console one page at a time
+void display_parking_report(struct registry_snapshot* snapshot, const struct parking_report* report) {
+    struct report_query query = { -1, 0, -1, 0, REPORT_PAGE_SIZE, REPORT_TEXT, stdout };
+    int matched;
+
+    printf("\n%s:\n", report->title);
+    printf("Space ID | %s\n", report->value_header);
+    printf("--------------------------------\n");
+
+    do {
+        struct parking_node* rows = select_parking_rows(snapshot->spaces, report, &query, &matched);
+        query.offset += write_parking_rows(rows, report, &query);
+    } while (query.offset < matched && next_page_wanted());
+
+    printf("--------------------------------\n");
+    printf("Showing %d of %d spaces\n", query.offset, matched);
+}
+
+// Display functions
+void display_sorted_by_parkings() {
+    struct registry_snapshot* snapshot = acquire_snapshot(1);
+    if (snapshot->vehicle_count == 0) {
+        printf("No vehicles registered.\n");
+    } else {
+        display_vehicle_report(snapshot, &parkings_report);
+    }
+    release_snapshot(snapshot);
+}
+
+void display_sorted_by_amount() {
+    struct registry_snapshot* snapshot = acquire_snapshot(1);
+    if (snapshot->vehicle_count == 0) {
+        printf("No vehicles registered.\n");
+    } else {
+        display_vehicle_report(snapshot, &amount_report);
+    }
+    release_snapshot(snapshot);
+}
+
+void display_sorted_by_occupancy() {
+    struct registry_snapshot* snapshot = acquire_snapshot(0);
+    display_parking_report(snapshot, &occupancy_report);
+
+    int total_occupied_spaces = 0;
+    for (struct parking_node* current = snapshot->spaces; current != NULL; current = current->next) {
+        if (current->occupancy_count > 0) {
+            total_occupied_spaces++;
+        }
+    }
+    printf("Total Occupied Spaces: %d\n", total_occupied_spaces);
+    release_snapshot(snapshot);
+}
+
+void display_sorted_by_revenue() {
+    struct registry_snapshot* snapshot = acquire_snapshot(0);
+    display_parking_report(snapshot, &revenue_report);
+
+    int total_revenue = 0;
+    int total_occupancy = 0;
+    for (struct parking_node* current = snapshot->spaces; current != NULL; current = current->next) {
+        total_revenue += current->space_revenue;
+        total_occupancy += current->occupancy_count;
+    }
+    printf("Total Revenue: Rs %d over %d occupancies\n", total_revenue, total_occupancy);
+    release_snapshot(snapshot);
+}
+
+// Reads one number for a menu prompt, returns 0 on bad input
+int read_number(const char* prompt, int* value) {
+    printf("%s", prompt);
+    if (scanf("%d", value) != 1) {
+        printf("Invalid input!\n");
+        while (getchar() != '\n');
+        return 0;
+    }
+    return 1;
+}
+
+// Structure for one export handed to a background thread
+struct export_job {
+    struct report_query query;
+    int report;
+    char file_name[64];
+};
+
+// Takes a snapshot and writes an export from it, then releases the snapshot and the job.
+// Both happen on the export thread, so reading cold records never holds up the console.
+void* export_worker(void* arg) {
+    struct export_job* job = (struct export_job*)arg;
+    struct report_query* query = &job->query;
+    int matched, written;
+    struct registry_snapshot* snapshot = acquire_snapshot(job->report <= 2);
+
+    if (job->report <= 2) {
+        const struct vehicle_report* chosen = job->report == 1 ? &parkings_report : &amount_report;
+        struct vehicle_node* rows = select_vehicle_rows(snapshot, chosen, query, &matched);
+        written = write_vehicle_rows(rows, chosen, query);
+    } else {
+        const struct parking_report* chosen = job->report == 3 ? &occupancy_report : &revenue_report;
+        struct parking_node* rows = select_parking_rows(snapshot->spaces, chosen, query, &matched);
+        written = write_parking_rows(rows, chosen, query);
+    }
+
+    if (fclose(query->out) != 0) {
+        printf("\nError: Writing %s failed.\n", job->file_name);
+    } else {
+        printf("\nExport finished: wrote %d of %d matching rows to %s\n", written, matched, job->file_name);
+    }
+    release_snapshot(snapshot);
+    free(job);
+
+    lock_registry();
+    exports_running--;
+#if PARKING_THREADS
+    pthread_cond_signal(&exports_done);
+#endif
+    unlock_registry();
+    return NULL;
+}
+
+// Function to wait for background exports before the registry is freed
+void wait_for_exports() {
+    lock_registry();
+#if PARKING_THREADS
+    while (exports_running > 0) {
+        pthread_cond_wait(&exports_done, &registry_lock);
+    }
+#endif
+    unlock_registry();
+}
+
+// Function to export a filtered slice of a report to a CSV or binary file.
+// The export reads a snapshot on a background thread, so gate events carry on meanwhile.
+void export_report() {
+    struct report_query query;
+    int report, format;
+    char file_name[64];
+
+    if (!read_number("Report (1 parkings, 2 amount paid, 3 occupancy, 4 revenue): ", &report)) return;
+    if (report < 1 || report > 4) {
+        printf("Unknown report.\n");
+        return;
+    }
+    if (!read_number("Format (1 CSV, 2 binary): ", &format)) return;
+    if (format != REPORT_CSV && format != REPORT_BINARY) {
+        printf("Unknown format.\n");
+        return;
+    }
+    if (!read_number("Membership filter (-1 any, 0 none, 1 premium, 2 gold): ", &query.membership)) return;
+    if (!read_number("Minimum value: ", &query.min_value)) return;
+    if (!read_number("Maximum value (-1 for no limit): ", &query.max_value)) return;
+    if (!read_number("Rows to skip: ", &query.offset)) return;
+    if (!read_number("Rows to write (0 for all): ", &query.limit)) return;
+    if (query.offset < 0 || query.limit < 0) {
+        printf("Row counts cannot be negative.\n");
+        return;
+    }
+    if (query.limit > INT_MAX - query.offset) {
+        printf("Rows to skip plus rows to write is too large.\n");
+        return;
+    }
+    printf("Output file name: ");
+    scanf("%63s", file_name);
+
+    query.format = format;
+    query.out = fopen(file_name, format == REPORT_BINARY ? "wb" : "w");
+    if (!query.out) {
+        printf("Error: Unable to open %s for writing.\n", file_name);
+        return;
+    }
+    setvbuf(query.out, NULL, _IOFBF, REPORT_BUFFER_SIZE);
+
+    struct export_job* job = (struct export_job*)malloc(sizeof(struct export_job));
+    if (job == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    job->query = query;
+    job->report = report;
+    strcpy(job->file_name, file_name);
+
+    lock_registry();
+    exports_running++;
+    unlock_registry();
+
+#if PARKING_THREADS
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, export_worker, job) == 0) {
+        pthread_detach(thread);
+        printf("Export to %s started in the background.\n", file_name);
+        return;
+    }
+#endif
+    export_worker(job);
+}
+
+// Structure for one simulated gate event, ordered by time and then by sequence
+// number so runs with the same seed replay identically
+struct sim_event {
+    uint32_t time;
+    uint32_t sequence;
+    int type;
+    int vehicle;
+};
+
+// Structure for the scenario a simulation run sweeps. With an hourly profile,
+// arrivals_per_hour holds the busiest hour's rate.
+struct sim_config {
+    uint64_t seed;
+    int days;
+    int space_count;
+    int arrival_profile;
+    int arrivals_per_hour;
+    int hourly_arrivals[24];
+    int tier_percent[3];
+    int mean_stay_hours[3];
+    struct lot_policy policy;
+};
+
+// Structure for what a simulation run measured
+struct sim_stats {
+    long arrivals[3];
+    long admitted[3];
+    long turned_away[3];
+    long revenue[3];
+    long events;
+    double occupied_minutes;
+    int peak_occupied;
+    int still_parked;
+};
+
+uint64_t sim_random_state;
+
+// xorshift64* generator, deterministic for a given seed
+double sim_uniform() {
+    sim_random_state ^= sim_random_state >> 12;
+    sim_random_state ^= sim_random_state << 25;
+    sim_random_state ^= sim_random_state >> 27;
+    return ((sim_random_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Exponentially distributed delay in whole minutes, at least one
+uint32_t sim_delay(double mean_minutes) {
+    double delay = -mean_minutes * log(1.0 - sim_uniform());
+    if (delay >= (double)UINT32_MAX) return UINT32_MAX;
+    return delay < 1.0 ? 1 : (uint32_t)delay;
+}
+
+// Adds a delay to a virtual time, stopping at end_time so a long delay cannot wrap
+uint32_t sim_after(uint32_t now, uint32_t delay, uint32_t end_time) {
+    return delay >= end_time - now ? end_time : now + delay;
+}
+
+// Minute of the next arrival. The arrival clock keeps fractions of a minute, so rates
+// above one a minute are not rounded away and several vehicles can arrive in the same
+// minute. An hourly profile is sampled by thinning: candidates come at the busiest
+// hour's rate and each is kept with probability rate of its hour / busiest rate.
+uint32_t sim_next_arrival(const struct sim_config* config, double* arrival_clock, uint32_t end_time) {
+    double mean_gap = 60.0 / config->arrivals_per_hour;
+    do {
+        *arrival_clock -= mean_gap * log(1.0 - sim_uniform());
+        if (*arrival_clock >= end_time) return end_time;
+    } while (config->arrival_profile == SIM_ARRIVALS_HOURLY &&
+             sim_uniform() * config->arrivals_per_hour >= config->hourly_arrivals[((uint32_t)*arrival_clock / 60) % 24]);
+    return (uint32_t)*arrival_clock;
+}
+
+int sim_event_before(const struct sim_event* a, const struct sim_event* b) {
+    return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+}
+
+void sim_push(struct sim_event* heap, int* size, struct sim_event event) {
+    int index = (*size)++;
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!sim_event_before(&event, &heap[parent])) break;
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = event;
+}
+
+struct sim_event sim_pop(struct sim_event* heap, int* size) {
+    struct sim_event top = heap[0];
+    struct sim_event last = heap[--(*size)];
+    int index = 0;
+    while (1) {
+        int child = 2 * index + 1;
+        if (child >= *size) break;
+        if (child + 1 < *size && sim_event_before(&heap[child + 1], &heap[child])) child++;
+        if (!sim_event_before(&heap[child], &last)) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    if (*size > 0) heap[index] = last;
+    return top;
+}
+
+// Runs one scenario on a private lot through admit_vehicle() and release_vehicle(),
+// the same allocation and billing code the gates use, with the scenario's layout and
+// tariff. The live registry is not touched. Revenue is totalled per tier in longs, and
+// each space's int revenue counter is cleared after a departure so long runs cannot overflow it.
+void simulate(const struct sim_config* config, struct sim_stats* stats) {
+    uint32_t end_time = (uint32_t)config->days * 24 * 60;
+    uint32_t sequence = 0;
+    uint32_t last_time = 0;
+    int occupied = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    sim_random_state = config->seed != 0 ? config->seed : 1;
+
+    // At most one pending arrival plus one departure per space
+    struct parking_node* lot = create_parking_lot(config->space_count);
+    struct sim_event* heap = (struct sim_event*)malloc((config->space_count + 1) * sizeof(struct sim_event));
+    struct vehicle_node* vehicles = (struct vehicle_node*)malloc((config->space_count + 1) * sizeof(struct vehicle_node));
+    struct parking_node** vehicle_spaces = (struct parking_node**)malloc((config->space_count + 1) * sizeof(struct parking_node*));
+    int* free_vehicles = (int*)malloc((config->space_count + 1) * sizeof(int));
+    if (heap == NULL || vehicles == NULL || vehicle_spaces == NULL || free_vehicles == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    int free_count = config->space_count + 1;
+    for (int i = 0; i < free_count; i++) {
+        free_vehicles[i] = i;
+    }
+
+    int heap_size = 0;
+    double arrival_clock = 0.0;
+    struct sim_event first = { sim_next_arrival(config, &arrival_clock, end_time), sequence++, ARRIVAL, -1 };
+    sim_push(heap, &heap_size, first);
+
+    while (heap_size > 0 && heap[0].time < end_time) {
+        struct sim_event event = sim_pop(heap, &heap_size);
+        stats->occupied_minutes += (double)occupied * (event.time - last_time);
+        last_time = event.time;
+        stats->events++;
+
+        if (event.type == ARRIVAL) {
+            int tier = NONE;
+            double pick = sim_uniform() * 100.0;
+            if (pick < config->tier_percent[GOLD]) {
+                tier = GOLD;
+            } else if (pick < config->tier_percent[GOLD] + config->tier_percent[PREMIUM]) {
+                tier = PREMIUM;
             }
-            head1 = head1->next;
-        } else {
-            if (result == NULL) {
-                result = tail = head2;
+            stats->arrivals[tier]++;
+
+            int index = free_vehicles[--free_count];
+            struct vehicle_node* vehicle = &vehicles[index];
+            memset(vehicle, 0, sizeof(*vehicle));
+            vehicle->membership = (unsigned char)tier;
+
+            vehicle_spaces[index] = admit_vehicle(lot, &config->policy, vehicle, event.time);
+            if (vehicle_spaces[index] != NULL) {
+                stats->admitted[tier]++;
+                occupied++;
+                if (occupied > stats->peak_occupied) stats->peak_occupied = occupied;
+                uint32_t stay = sim_delay(config->mean_stay_hours[tier] * 60.0);
+                struct sim_event departure = { sim_after(event.time, stay, end_time), sequence++, DEPARTURE, index };
+                sim_push(heap, &heap_size, departure);
             } else {
-                tail->next = head2;
-                tail = head2;
+                stats->turned_away[tier]++;
+                free_vehicles[free_count++] = index;
             }
-            head2 = head2->next;
+
+            struct sim_event next = { sim_next_arrival(config, &arrival_clock, end_time), sequence++, ARRIVAL, -1 };
+            sim_push(heap, &heap_size, next);
+        } else {
+            struct vehicle_node* vehicle = &vehicles[event.vehicle];
+            int tier = vehicle->membership;
+            int parked_hours;
+            stats->revenue[tier] += release_vehicle(lot, &config->policy, vehicle, event.time, &parked_hours);
+            vehicle_spaces[event.vehicle]->space_revenue = 0;
+            occupied--;
+            free_vehicles[free_count++] = event.vehicle;
         }
     }
+    stats->occupied_minutes += (double)occupied * (end_time - last_time);
+    stats->still_parked = occupied;
 
-    if (head1 != NULL) {
-        if (result == NULL) result = head1;
-        else tail->next = head1;
+    free(heap);
+    free(vehicles);
+    free(vehicle_spaces);
+    free(free_vehicles);
+    while (lot != NULL) {
+        struct parking_node* temp = lot;
+        lot = lot->next;
+        free(temp);
     }
-    if (head2 != NULL) {
-        if (result == NULL) result = head2;
-        else tail->next = head2;
+}
+
+// Function to run a capacity planning scenario on a virtual clock
+void run_simulation() {
+    struct sim_config config;
+    struct sim_stats stats;
+    int seed, discount_percent;
+    char prompt[48];
+
+    if (!read_number("Random seed: ", &seed)) return;
+    if (!read_number("Days to simulate: ", &config.days)) return;
+    if (!read_number("Number of spaces: ", &config.space_count)) return;
+    if (!read_number("Last gold space (gates use 10): ", &config.policy.gold_last_space)) return;
+    if (!read_number("Last premium space (gates use 20): ", &config.policy.premium_last_space)) return;
+    if (!read_number("Arrival pattern (1 constant rate, 2 hourly profile): ", &config.arrival_profile)) return;
+    if (config.arrival_profile == SIM_ARRIVALS_CONSTANT) {
+        if (!read_number("Arrivals per hour: ", &config.arrivals_per_hour)) return;
+    } else if (config.arrival_profile == SIM_ARRIVALS_HOURLY) {
+        config.arrivals_per_hour = 0;
+        for (int hour = 0; hour < 24; hour++) {
+            snprintf(prompt, sizeof(prompt), "Arrivals per hour from %02d:00: ", hour);
+            if (!read_number(prompt, &config.hourly_arrivals[hour])) return;
+            if (config.hourly_arrivals[hour] < 0 || config.hourly_arrivals[hour] > SIM_MAX_ARRIVALS_PER_HOUR) {
+                printf("Invalid profile: each hour needs 0-%d arrivals.\n", SIM_MAX_ARRIVALS_PER_HOUR);
+                return;
+            }
+            if (config.hourly_arrivals[hour] > config.arrivals_per_hour) {
+                config.arrivals_per_hour = config.hourly_arrivals[hour];
+            }
+        }
+    } else {
+        printf("Unknown arrival pattern.\n");
+        return;
     }
+    if (!read_number("Percent of arrivals with gold membership: ", &config.tier_percent[GOLD])) return;
+    if (!read_number("Percent of arrivals with premium membership: ", &config.tier_percent[PREMIUM])) return;
+    if (!read_number("Mean stay in hours for gold: ", &config.mean_stay_hours[GOLD])) return;
+    if (!read_number("Mean stay in hours for premium: ", &config.mean_stay_hours[PREMIUM])) return;
+    if (!read_number("Mean stay in hours for no membership: ", &config.mean_stay_hours[NONE])) return;
+    if (!read_number("Base fee in Rs (gates charge 100): ", &config.policy.base_fee)) return;
+    if (!read_number("Hours covered by the base fee (gates use 3): ", &config.policy.base_hours)) return;
+    if (!read_number("Fee per extra hour in Rs (gates charge 50): ", &config.policy.extra_fee)) return;
+    if (!read_number("Member discount percent (gates give 10): ", &discount_percent)) return;
+    config.seed = (uint64_t)(unsigned int)seed;
+    config.tier_percent[NONE] = 100 - config.tier_percent[GOLD] - config.tier_percent[PREMIUM];
+    config.policy.discount = discount_percent / 100.0;
 
-    return result;
+    // Upper limits keep virtual times inside 32 bits and a single fee inside an int
+    if (config.days <= 0 || config.days > SIM_MAX_DAYS || config.space_count <= 0 || config.space_count > 65535 ||
+        config.arrivals_per_hour <= 0 || config.arrivals_per_hour > SIM_MAX_ARRIVALS_PER_HOUR ||
+        config.tier_percent[GOLD] < 0 || config.tier_percent[PREMIUM] < 0 || config.tier_percent[NONE] < 0 ||
+        config.mean_stay_hours[GOLD] <= 0 || config.mean_stay_hours[PREMIUM] <= 0 || config.mean_stay_hours[NONE] <= 0 ||
+        config.mean_stay_hours[GOLD] > SIM_MAX_STAY_HOURS || config.mean_stay_hours[PREMIUM] > SIM_MAX_STAY_HOURS ||
+        config.mean_stay_hours[NONE] > SIM_MAX_STAY_HOURS) {
+        printf("Invalid scenario: up to %d days, 65535 spaces and %d arrivals per hour, stays of 1-%d hours, "
+               "and percentages adding up to at most 100.\n", SIM_MAX_DAYS, SIM_MAX_ARRIVALS_PER_HOUR, SIM_MAX_STAY_HOURS);
+        return;
+    }
+    if ((long long)config.days * 24 * config.arrivals_per_hour > SIM_MAX_ARRIVALS) {
+        printf("Scenario too long: days x 24 x arrivals per hour (busiest hour for a profile) must be at most %lld.\n",
+               SIM_MAX_ARRIVALS);
+        return;
+    }
+    if (config.policy.gold_last_space < 0 || config.policy.premium_last_space < config.policy.gold_last_space ||
+        config.policy.premium_last_space > config.space_count || config.policy.base_fee < 0 ||
+        config.policy.base_fee > SIM_MAX_FEE || config.policy.base_hours < 0 ||
+        config.policy.base_hours > SIM_MAX_STAY_HOURS || config.policy.extra_fee < 0 ||
+        config.policy.extra_fee > SIM_MAX_EXTRA_FEE || discount_percent < 0 || discount_percent > 100) {
+        printf("Invalid layout or tariff: space ranges must fit the lot, the base fee is 0-%d Rs, the extra hour "
+               "fee 0-%d Rs and the discount 0-100%%.\n", SIM_MAX_FEE, SIM_MAX_EXTRA_FEE);
+        return;
+    }
+
+    clock_t started = clock();
+    simulate(&config, &stats);
+    double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+    long total_revenue = 0;
+    printf("\n=== Simulation Results ===\n");
+    printf("Tier     | Arrivals | Parked   | Turned Away | Revenue (Rs)\n");
+    printf("------------------------------------------------------------\n");
+    for (int tier = GOLD; tier >= NONE; tier--) {
+        printf("%-8s | %-8ld | %-8ld | %-11ld | %ld\n", membership_name(tier),
+               stats.arrivals[tier], stats.admitted[tier], stats.turned_away[tier], stats.revenue[tier]);
+        total_revenue += stats.revenue[tier];
+    }
+    printf("------------------------------------------------------------\n");
+    printf("Total revenue: %ld Rs\n", total_revenue);
+    printf("Utilisation: %.1f%% (peak %d of %d spaces)\n",
+           100.0 * stats.occupied_minutes / ((double)config.space_count * config.days * 24 * 60),
+           stats.peak_occupied, config.space_count);
+    printf("Still parked at end: %d\n", stats.still_parked);
+    printf("Simulated %ld events in %.3f s", stats.events, seconds);
+    if (seconds > 0) {
+        printf(" (%.0f events/s)", stats.events / seconds);
+    }
+    printf("\n");
 }
 
-struct parking_node* merge_by_revenue(struct parking_node* head1, struct parking_node* head2) {
-    struct parking_node* result = NULL;
-    struct parking_node* tail = NULL;
+// Structure for writing cold vehicles to vehicles.txt
+struct text_export {
+    FILE* file;
+    int saved;
+};
 
-    while (head1 != NULL && head2 != NULL) {
-        if (head1->space_revenue >= head2->space_revenue) {
-            if (result == NULL) {
-                result = tail = head1;
-            } else {
-                tail->next = head1;
-                tail = head1;
-            }
-            head1 = head1->next;
+void write_vehicle_line(FILE* file, uint64_t plate, const char* owner_name, int total_parking_hours,
+                        int total_amount_paid, int parking_count, int membership, int parking_ID) {
+    char plate_text[VEHICLE_NUM_SIZE];
+    decode_plate(plate, plate_text);
+    fprintf(file, "%s %s %d %d %d %d %d\n", plate_text, owner_name, total_parking_hours,
+            total_amount_paid, parking_count, membership, parking_ID);
+}
+
+void export_cold_record(const struct vehicle_record* record, int slot, void* context) {
+    struct text_export* export = (struct text_export*)context;
+    char owner_name[OWNER_NAME_SIZE];
+    int length = (int)strnlen(record->owner_name, OWNER_NAME_SIZE - 1);
+    memcpy(owner_name, record->owner_name, length);
+    owner_name[length] = '\0';
+    (void)slot;
+
+    write_vehicle_line(export->file, record->plate, owner_name, record->total_parking_hours,
+                       record->total_amount_paid, record->parking_count, record_membership(record), record->parking_ID);
+    export->saved++;
+}
+
+// Function to write all data to the text files, for reading or for moving to another system
+void export_text_data() {
+    printf("Exporting data to text files...\n");
+    
+    // Save vehicle data
+    FILE *vehicle_file = fopen("vehicles.txt", "w");
+    if (!vehicle_file) {
+        printf("Error: Unable to save vehicle data.\n");
+        return;
+    }
+
+    lock_registry();
+    struct text_export export;
+    export.file = vehicle_file;
+    export.saved = 0;
+    struct vehicle_node* current_vehicle = vehicle_list;
+    while (current_vehicle != NULL) {
+        write_vehicle_line(vehicle_file, current_vehicle->plate, current_vehicle->owner_name,
+                           current_vehicle->total_parking_hours, current_vehicle->total_amount_paid,
+                           current_vehicle->parking_count, current_vehicle->membership, current_vehicle->parking_ID);
+        current_vehicle = current_vehicle->next;
+        export.saved++;
+    }
+    scan_cold_records(export_cold_record, &export);
+    unlock_registry();
+    fclose(vehicle_file);
+    printf("Saved %d vehicles to vehicles.txt\n", export.saved);
+
+    // Save parking space data
+    FILE *parking_file = fopen("parking_spaces.txt", "w");
+    if (!parking_file) {
+        printf("Error: Unable to save parking space data.\n");
+        return;
+    }
+
+    struct parking_node* current_parking = parking_list;
+    int saved_spaces = 0;
+    while (current_parking != NULL) {
+        fprintf(parking_file, "%d %d %d %d\n",
+                current_parking->parking_space_ID,
+                current_parking->status,
+                current_parking->occupancy_count,
+                current_parking->space_revenue);
+        current_parking = current_parking->next;
+        saved_spaces++;
+    }
+    fclose(parking_file);
+    printf("Saved %d parking spaces to parking_spaces.txt\n", saved_spaces);
+}
+
+int compare_vehicle_slots(const void* a, const void* b) {
+    int slot1 = (*(struct vehicle_node* const*)a)->slot;
+    int slot2 = (*(struct vehicle_node* const*)b)->slot;
+    return (slot1 > slot2) - (slot1 < slot2);
+}
+
+// Opens a store file for update, creating it with a header if it does not exist.
+// Returns the number of records already in it; exits if the file is not the expected store.
+long open_store(const char* file_name, const char* magic, uint32_t record_size, FILE** store) {
+    struct store_header header;
+
+    *store = fopen(file_name, "r+b");
+    if (*store == NULL) {
+        *store = fopen(file_name, "w+b");
+        if (*store == NULL) {
+            printf("Error: Unable to create %s.\n", file_name);
+            exit(1);
+        }
+        memcpy(header.magic, magic, 4);
+        header.record_size = record_size;
+        fwrite(&header, sizeof(header), 1, *store);
+        fflush(*store);
+        return 0;
+    }
+
+    if (fread(&header, sizeof(header), 1, *store) != 1 ||
+        memcmp(header.magic, magic, 4) != 0 || header.record_size != record_size) {
+        printf("Error: %s is not a compatible data file.\n", file_name);
+        exit(1);
+    }
+    fseek(*store, 0, SEEK_END);
+    long records = (ftell(*store) - (long)sizeof(header)) / record_size;
+    fseek(*store, sizeof(header), SEEK_SET);
+    return records;
+}
+
+// Start of the window of recent arrivals kept in memory, in minutes like datetime_to_minutes
+int64_t resident_window_start() {
+    time_t now = time(NULL);
+    struct tm* local = localtime(&now);
+    struct datetime today;
+    today.time = local->tm_hour;
+    today.date = local->tm_mday;
+    today.month = local->tm_mon + 1;
+    today.year = local->tm_year + 1900;
+    return (int64_t)datetime_to_minutes(today) - (int64_t)RESIDENT_WINDOW_DAYS * 24 * 60;
+}
+
+// A stored vehicle is kept in memory if it arrived within the window or still holds its space.
+// Decided from the record alone, so nothing is allocated for the vehicles left on disk.
+int record_is_hot(const struct vehicle_record* record, int64_t window_start) {
+    return (int64_t)record->arrival >= window_start || unclaimed_space(record->parking_ID) != NULL;
+}
+
+// Makes a stored vehicle resident while loading, the list has room for it
+void load_resident_record(const struct vehicle_record* record, int slot) {
+    struct vehicle_node* new_vehicle = vehicle_from_record(record, slot);
+    new_vehicle->next = vehicle_list;
+    vehicle_list = new_vehicle;
+    resident_count++;
+    set_slot_resident(slot, 1);
+    claim_space(new_vehicle);
+}
+
+int compare_index_entries(const void* a, const void* b) {
+    uint64_t plate1 = ((const struct index_entry*)a)->plate;
+    uint64_t plate2 = ((const struct index_entry*)b)->plate;
+    return (plate1 > plate2) - (plate1 < plate2);
+}
+
+int compare_slots(const void* a, const void* b) {
+    int slot1 = *(const int*)a;
+    int slot2 = *(const int*)b;
+    return (slot1 > slot2) - (slot1 < slot2);
+}
+
+// Opens vehicles.idx and reads its page fences. Returns 0 if it is missing or does not
+// fit a store of the given number of records, then it has to be built again.
+int open_plate_index(long records) {
+    struct index_header header;
+    FILE* file = fopen("vehicles.idx", "rb");
+    if (file == NULL) return 0;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "PKX1", 4) != 0 ||
+        header.entry_size != sizeof(struct index_entry) || header.slot_count > (uint32_t)records ||
+        header.entry_count > header.slot_count) {
+        fclose(file);
+        return 0;
+    }
+    int pages = (int)((header.entry_count + INDEX_PAGE_ENTRIES - 1) / INDEX_PAGE_ENTRIES);
+    long expected = (long)sizeof(header) + (long)pages * (long)sizeof(uint64_t) +
+                    (long)header.entry_count * (long)sizeof(struct index_entry);
+    uint64_t* fences = (uint64_t*)malloc(pages * sizeof(uint64_t) + 1);
+    if (fences == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) != expected || fseek(file, sizeof(header), SEEK_SET) != 0 ||
+        fread(fences, sizeof(uint64_t), pages, file) != (size_t)pages) {
+        free(fences);
+        fclose(file);
+        return 0;
+    }
+
+    if (plate_index != NULL) fclose(plate_index);
+    free(index_fences);
+    plate_index = file;
+    index_fences = fences;
+    index_count = (int)header.entry_count;
+    index_pages = pages;
+    index_slot_count = (int)header.slot_count;
+    index_page_number = -1;
+    return 1;
+}
+
+// Writes vehicles.idx as the current index merged with the sorted entries given, covering
+// every slot below slot_count. The new file replaces the old one only once it is complete.
+void write_plate_index(const struct index_entry* added, int added_count, int slot_count) {
+    struct index_header header;
+    int total = index_count + added_count;
+    int pages = (total + INDEX_PAGE_ENTRIES - 1) / INDEX_PAGE_ENTRIES;
+    uint64_t* fences = (uint64_t*)calloc(pages + 1, sizeof(uint64_t));
+    if (fences == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    FILE* file = fopen("vehicles.idx.new", "wb");
+    if (file == NULL) {
+        printf("Error: Unable to write vehicles.idx.\n");
+        free(fences);
+        return;
+    }
+
+    memcpy(header.magic, "PKX1", 4);
+    header.entry_size = sizeof(struct index_entry);
+    header.entry_count = (uint32_t)total;
+    header.slot_count = (uint32_t)slot_count;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(fences, sizeof(uint64_t), pages, file);
+
+    int i = 0;
+    int j = 0;
+    for (int written = 0; written < total; written++) {
+        struct index_entry entry;
+        uint64_t plate = i < index_count ? index_plate_at(i) : 0;
+        if (j == added_count || (i < index_count && plate <= added[j].plate)) {
+            entry = index_page[i % INDEX_PAGE_ENTRIES];
+            i++;
         } else {
-            if (result == NULL) {
-                result = tail = head2;
+            entry = added[j++];
+        }
+        if (written % INDEX_PAGE_ENTRIES == 0) fences[written / INDEX_PAGE_ENTRIES] = entry.plate;
+        fwrite(&entry, sizeof(entry), 1, file);
+    }
+    fseek(file, sizeof(header), SEEK_SET);
+    fwrite(fences, sizeof(uint64_t), pages, file);
+    int failed = ferror(file);
+    if (fclose(file) != 0) failed = 1;
+    free(fences);
+    if (failed) {
+        printf("Error: Unable to write vehicles.idx.\n");
+        remove("vehicles.idx.new");
+        return;
+    }
+
+    if (plate_index != NULL) {
+        fclose(plate_index);
+        plate_index = NULL;
+    }
+    remove("vehicles.idx");
+    if (rename("vehicles.idx.new", "vehicles.idx") != 0 || !open_plate_index(slot_count)) {
+        printf("Error: Unable to replace vehicles.idx.\n");
+        free(index_fences);
+        index_fences = NULL;
+        index_count = 0;
+        index_pages = 0;
+        index_slot_count = 0;
+    }
+}
+
+// Builds vehicles.idx from a full read of vehicles.dat, for a store without a usable index.
+// Returns the slots of the vehicles to keep in memory, sorted, in place of vehicles.hot.
+int* rebuild_plate_index(long records, int64_t window_start, int* hot_count) {
+    struct vehicle_record* batch = (struct vehicle_record*)malloc(STORE_BATCH_RECORDS * sizeof(struct vehicle_record));
+    struct index_entry* entries = (struct index_entry*)malloc(records * sizeof(struct index_entry));
+    int* hot_slots = (int*)malloc(MAX_RESIDENT_VEHICLES * sizeof(int));
+    if (batch == NULL || entries == NULL || hot_slots == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+
+    *hot_count = 0;
+    fseek(vehicle_store, sizeof(struct store_header), SEEK_SET);
+    long slot = 0;
+    while (slot < records) {
+        size_t read = fread(batch, sizeof(struct vehicle_record), STORE_BATCH_RECORDS, vehicle_store);
+        if (read == 0) break;
+        for (size_t i = 0; i < read && slot < records; i++, slot++) {
+            entries[slot].plate = batch[i].plate;
+            entries[slot].slot = (int32_t)slot;
+            entries[slot].reserved = 0;
+            if (*hot_count < MAX_RESIDENT_VEHICLES && record_is_hot(&batch[i], window_start)) {
+                hot_slots[(*hot_count)++] = (int)slot;
+            }
+        }
+    }
+    free(batch);
+
+    qsort(entries, slot, sizeof(struct index_entry), compare_index_entries);
+    write_plate_index(entries, (int)slot, (int)slot);
+    free(entries);
+    return hot_slots;
+}
+
+// Adds the slots written since vehicles.idx was last saved to it, called with registry_lock held
+void update_plate_index() {
+    int added_count = next_vehicle_slot - index_slot_count;
+    struct index_entry* added = (struct index_entry*)malloc(added_count * sizeof(struct index_entry));
+    if (added == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+
+    struct vehicle_record record;
+    fseek(vehicle_store, (long)sizeof(struct store_header) + (long)index_slot_count * (long)sizeof(record), SEEK_SET);
+    for (int i = 0; i < added_count; i++) {
+        if (fread(&record, sizeof(record), 1, vehicle_store) != 1) {
+            printf("Error: Unable to read vehicle record %d.\n", index_slot_count + i);
+            free(added);
+            return;
+        }
+        added[i].plate = record.plate;
+        added[i].slot = index_slot_count + i;
+        added[i].reserved = 0;
+    }
+    qsort(added, added_count, sizeof(struct index_entry), compare_index_entries);
+    write_plate_index(added, added_count, next_vehicle_slot);
+    free(added);
+}
+
+// Saves the slots of the vehicles in memory to vehicles.hot, the next start loads the
+// ones still recent or parked without reading the rest of the store. Called with registry_lock held.
+void write_hot_slots() {
+    struct store_header header;
+    FILE* file = fopen("vehicles.hot", "wb");
+    if (file == NULL) {
+        printf("Error: Unable to write vehicles.hot.\n");
+        return;
+    }
+    memcpy(header.magic, "PKH1", 4);
+    header.record_size = sizeof(int32_t);
+    fwrite(&header, sizeof(header), 1, file);
+    for (struct vehicle_node* current = vehicle_list; current != NULL; current = current->next) {
+        if (current->slot < 0) continue;
+        int32_t slot = current->slot;
+        fwrite(&slot, sizeof(slot), 1, file);
+    }
+    fclose(file);
+}
+
+// Reads vehicles.hot, returns its slots sorted
+int* read_hot_slots(int* hot_count) {
+    struct store_header header;
+    *hot_count = 0;
+    FILE* file = fopen("vehicles.hot", "rb");
+    if (file == NULL) return NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "PKH1", 4) != 0 ||
+        header.record_size != sizeof(int32_t)) {
+        fclose(file);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long count = (ftell(file) - (long)sizeof(header)) / (long)sizeof(int32_t);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    int* hot_slots = (int*)malloc(count * sizeof(int) + 1);
+    if (hot_slots == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    int32_t slot;
+    while (*hot_count < count && fread(&slot, sizeof(slot), 1, file) == 1) {
+        hot_slots[(*hot_count)++] = slot;
+    }
+    fclose(file);
+    qsort(hot_slots, *hot_count, sizeof(int), compare_slots);
+    return hot_slots;
+}
+
+// Loads the hot part of vehicles.dat: the vehicles listed in vehicles.hot that arrived within
+// the last RESIDENT_WINDOW_DAYS or are parked now, up to MAX_RESIDENT_VEHICLES, and the records
+// written after vehicles.idx was saved. The rest is only read when its plate is looked up, so
+// startup time and memory follow the active vehicles, not the whole registry. Without a usable
+// vehicles.idx the store is read once to build it. Called after the parking spaces are loaded.
+void load_vehicle_store(long records) {
+    int64_t window_start = resident_window_start();
+    int hot_count = 0;
+    int* hot_slots = NULL;
+    if (open_plate_index(records)) {
+        hot_slots = read_hot_slots(&hot_count);
+    } else {
+        printf("Building vehicles.idx...\n");
+        hot_slots = rebuild_plate_index(records, window_start, &hot_count);
+    }
+
+    struct vehicle_record record;
+    int expected_slot = -1;
+    for (int i = 0; i < hot_count && resident_count < MAX_RESIDENT_VEHICLES; i++) {
+        int slot = hot_slots[i];
+        if (slot < 0 || slot >= records || slot_is_resident(slot)) continue;
+        if (slot != expected_slot) {
+            fseek(vehicle_store, (long)sizeof(struct store_header) + (long)slot * (long)sizeof(record), SEEK_SET);
+        }
+        expected_slot = -1;
+        if (fread(&record, sizeof(record), 1, vehicle_store) != 1) continue;
+        expected_slot = slot + 1;
+        if (record_is_hot(&record, window_start)) {
+            load_resident_record(&record, slot);
+        }
+    }
+    free(hot_slots);
+
+    // Records saved after the index was written are not in it, they go into the trie
+    int tail_count = (int)records - index_slot_count;
+    struct vehicle_record* batch = (struct vehicle_record*)malloc(STORE_BATCH_RECORDS * sizeof(struct vehicle_record));
+    struct indexed_plate* cold = (struct indexed_plate*)malloc(tail_count * sizeof(struct indexed_plate) + 1);
+    if (batch == NULL || cold == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    int cold_count = 0;
+    long slot = index_slot_count;
+    fseek(vehicle_store, (long)sizeof(struct store_header) + slot * (long)sizeof(record), SEEK_SET);
+    while (slot < records) {
+        size_t read = fread(batch, sizeof(struct vehicle_record), STORE_BATCH_RECORDS, vehicle_store);
+        if (read == 0) break;
+        for (size_t i = 0; i < read && slot < records; i++, slot++) {
+            if (slot_is_resident((int)slot)) continue;
+            if (resident_count < MAX_RESIDENT_VEHICLES && record_is_hot(&batch[i], window_start)) {
+                load_resident_record(&batch[i], (int)slot);
             } else {
-                tail->next = head2;
-                tail = head2;
+                cold[cold_count].plate = batch[i].plate;
+                cold[cold_count].slot = (int)slot;
+                cold[cold_count].vehicle = NULL;
+                cold_count++;
             }
-            head2 = head2->next;
         }
     }
+    free(batch);
 
-    if (head1 != NULL) {
-        if (result == NULL) result = head1;
-        else tail->next = head1;
+    vehicle_count = (int)records;
+    next_vehicle_slot = (int)records;
+    build_plate_index(cold, cold_count);
+    free(cold);
+}
+
+// Calls visit for every record of a store file below scan->slot_count whose slot is not
+// marked resident in scan, in slot order
+void scan_store_records(FILE* store, const struct cold_scan* scan,
+                        void (*visit)(const struct vehicle_record* record, int slot, void* context), void* context) {
+    struct vehicle_record* batch = (struct vehicle_record*)malloc(STORE_BATCH_RECORDS * sizeof(struct vehicle_record));
+    if (batch == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
     }
-    if (head2 != NULL) {
-        if (result == NULL) result = head2;
-        else tail->next = head2;
+    fseek(store, sizeof(struct store_header), SEEK_SET);
+    int slot = 0;
+    while (slot < scan->slot_count) {
+        size_t read = fread(batch, sizeof(struct vehicle_record), STORE_BATCH_RECORDS, store);
+        if (read == 0) break;
+        for (size_t i = 0; i < read && slot < scan->slot_count; i++, slot++) {
+            if (!scan_slot_resident(scan, slot)) {
+                visit(&batch[i], slot, context);
+            }
+        }
     }
+    free(batch);
+}
 
-    return result;
+// Calls visit for every record of vehicles.dat whose vehicle is not in memory,
+// in slot order, called with registry_lock held
+void scan_cold_records(void (*visit)(const struct vehicle_record* record, int slot, void* context), void* context) {
+    if (resident_count == vehicle_count) return;
+
+    struct cold_scan live;
+    live.slot_count = next_vehicle_slot;
+    live.resident = resident_slots;
+    live.resident_size = resident_slots_size;
+    live.next = NULL;
+    scan_store_records(vehicle_store, &live, visit, context);
 }
 
-// Generic divide function
-struct vehicle_node* divide(struct vehicle_node* head) {
-    struct vehicle_node* fast = head;
-    struct vehicle_node* slow = head;
-    struct vehicle_node* prev = NULL;
-    
-    while (fast != NULL && fast->next != NULL) {
-        fast = fast->next->next;
-        prev = slow;
-        slow = slow->next;
+// Reads every record of parking_spaces.dat, keeping file order.
+// With FIXED_LOT the records fill the fixed layout instead; returns 0 if they were not
+// stored in layout order, so the whole store has to be rewritten.
+int load_parking_store(long records) {
+    struct parking_record record;
+#if FIXED_LOT
+    int in_layout = records == MAX_PARKING_SPACES;
+    for (long i = 0; i < records && fread(&record, sizeof(record), 1, parking_store) == 1; i++) {
+        struct parking_node* space = space_in_lot(fixed_spaces, record.parking_space_ID);
+        if (space == NULL) {
+            printf("Space %d is outside the fixed lot, skipped.\n", record.parking_space_ID);
+            in_layout = 0;
+            continue;
+        }
+        set_space_status(fixed_spaces, space, record.status);
+        space->occupancy_count = record.occupancy_count;
+        space->space_revenue = record.space_revenue;
+        space->dirty = 0;
+        if (record.parking_space_ID != i + 1) in_layout = 0;
     }
-    
-    if (prev != NULL) {
-        prev->next = NULL;
+    return in_layout;
+#else
+    struct parking_node* tail = NULL;
+
+    for (long i = 0; i < records && fread(&record, sizeof(record), 1, parking_store) == 1; i++) {
+        struct parking_node* new_parking = create_parking_node(record.parking_space_ID);
+        new_parking->status = record.status;
+        new_parking->occupancy_count = record.occupancy_count;
+        new_parking->space_revenue = record.space_revenue;
+
+        if (parking_list == NULL) {
+            parking_list = new_parking;
+        } else {
+            tail->next = new_parking;
+        }
+        tail = new_parking;
     }
-    
-    return slow;
+    return 1;
+#endif
 }
 
-struct parking_node* divide_parking(struct parking_node* head) {
-    struct parking_node* fast = head;
-    struct parking_node* slow = head;
-    struct parking_node* prev = NULL;
-    
-    while (fast != NULL && fast->next != NULL) {
-        fast = fast->next->next;
-        prev = slow;
-        slow = slow->next;
-    }
-    
-    if (prev != NULL) {
-        prev->next = NULL;
+// Writes the parking spaces changed since the last checkpoint into their slots, returns how many
+int write_dirty_spaces() {
+    long slot = 0;
+    long expected_position = -1;
+    int written = 0;
+    for (struct parking_node* current = parking_list; current != NULL; current = current->next, slot++) {
+        if (!current->dirty) continue;
+        struct parking_record record;
+        record.parking_space_ID = current->parking_space_ID;
+        record.status = current->status;
+        record.occupancy_count = current->occupancy_count;
+        record.space_revenue = current->space_revenue;
+
+        long position = (long)sizeof(struct store_header) + slot * (long)sizeof(record);
+        if (position != expected_position) {
+            fseek(parking_store, position, SEEK_SET);
+        }
+        fwrite(&record, sizeof(record), 1, parking_store);
+        expected_position = position + (long)sizeof(record);
+        current->dirty = 0;
+        written++;
     }
-    
-    return slow;
+    fflush(parking_store);
+    return written;
 }
 
-// Merge sort functions
-struct vehicle_node* mergeSort_by_parkings(struct vehicle_node* head) {
-    if (head == NULL || head->next == NULL) return head;
+// Writes only the records changed since the last checkpoint, each into its own slot.
+// Writes are ordered by slot so runs of neighbouring records go out as one sequential write.
+// Returns the number of records written.
+int checkpoint() {
+    int written = 0;
 
-    struct vehicle_node* middle = divide(head);
-    struct vehicle_node* left = mergeSort_by_parkings(head);
-    struct vehicle_node* right = mergeSort_by_parkings(middle);
+    lock_registry();
+    for (int i = 0; i < dirty_count; i++) {
+        if (dirty_vehicles[i]->slot < 0) {
+            dirty_vehicles[i]->slot = next_vehicle_slot++;
+            set_slot_resident(dirty_vehicles[i]->slot, 1);
+        }
+    }
+    if (dirty_count > 1) {
+        qsort(dirty_vehicles, dirty_count, sizeof(struct vehicle_node*), compare_vehicle_slots);
+    }
 
-    return merge_by_parkings(left, right);
-}
+    long expected_position = -1;
+    int kept = 0;
+    for (int i = 0; i < dirty_count; i++) {
+        struct vehicle_node* vehicle = dirty_vehicles[i];
+        if (slot_being_scanned(vehicle->slot)) {
+            // A snapshot is reading the old record without the lock, write it next time
+            dirty_vehicles[kept++] = vehicle;
+            continue;
+        }
+        struct vehicle_record record;
+        memset(&record, 0, sizeof(record));
+        record.plate = vehicle->plate;
+        record.arrival = vehicle->arrival;
+        record.total_parking_hours = vehicle->total_parking_hours;
+        record.total_amount_paid = vehicle->total_amount_paid;
+        record.parking_count = vehicle->parking_count;
+        record.parking_ID = vehicle->parking_ID;
+        record.membership = vehicle->membership;
+        memcpy(record.owner_name, vehicle->owner_name, strnlen(vehicle->owner_name, OWNER_NAME_SIZE - 1));
 
-struct vehicle_node* mergeSort_by_amount(struct vehicle_node* head) {
-    if (head == NULL || head->next == NULL) return head;
-    
-    struct vehicle_node* middle = divide(head);
-    struct vehicle_node* left = mergeSort_by_amount(head);
-    struct vehicle_node* right = mergeSort_by_amount(middle);
-    
-    return merge_by_amount(left, right);
-}
+        long position = (long)sizeof(struct store_header) + (long)vehicle->slot * (long)sizeof(record);
+        if (position != expected_position) {
+            fseek(vehicle_store, position, SEEK_SET);
+        }
+        fwrite(&record, sizeof(record), 1, vehicle_store);
+        expected_position = position + (long)sizeof(record);
+        vehicle->dirty = 0;
+        written++;
+    }
+    dirty_count = kept;
+    fflush(vehicle_store);
 
-struct parking_node* mergeSort_by_occupancy(struct parking_node* head) {
-    if (head == NULL || head->next == NULL) return head;
-    
-    struct parking_node* middle = divide_parking(head);
-    struct parking_node* left = mergeSort_by_occupancy(head);
-    struct parking_node* right = mergeSort_by_occupancy(middle);
-    
-    return merge_by_occupancy(left, right);
+    written += write_dirty_spaces();
+    unlock_registry();
+    return written;
 }
 
-struct parking_node* mergeSort_by_revenue(struct parking_node* head) {
-    if (head == NULL || head->next == NULL) return head;
-    
-    struct parking_node* middle = divide_parking(head);
-    struct parking_node* left = mergeSort_by_revenue(head);
-    struct parking_node* right = mergeSort_by_revenue(middle);
-    
-    return merge_by_revenue(left, right);
+#if PARKING_THREADS
+// Timer thread that writes changed records every CHECKPOINT_SECONDS, including while the
+// console sits waiting for input. It sleeps on checkpoint_wakeup so stopping it is immediate.
+void* checkpoint_worker(void* arg) {
+    (void)arg;
+    lock_registry();
+    while (checkpoint_timer_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += CHECKPOINT_SECONDS;
+        int result = 0;
+        while (checkpoint_timer_running && result != ETIMEDOUT) {
+            result = pthread_cond_timedwait(&checkpoint_wakeup, &registry_lock, &deadline);
+        }
+        if (!checkpoint_timer_running) break;
+        unlock_registry();
+        checkpoint();
+        lock_registry();
+    }
+    unlock_registry();
+    return NULL;
 }
+#endif
 
-// Display functions
-void display_sorted_by_parkings() {
-    if (vehicle_count == 0) {
-        printf("No vehicles registered.\n");
-        return;
+// Function to start the checkpoint timer, returns 0 if checkpoints are left to the menu loop
+int start_checkpoint_timer() {
+#if PARKING_THREADS
+    checkpoint_timer_running = 1;
+    if (pthread_create(&checkpoint_thread, NULL, checkpoint_worker, NULL) == 0) {
+        return 1;
     }
+    checkpoint_timer_running = 0;
+#endif
+    return 0;
+}
 
-    struct vehicle_node* list_copy = copy_list(vehicle_list);
-    struct vehicle_node* sorted_list = mergeSort_by_parkings(list_copy);
+// Function to stop the checkpoint timer before the final save
+void stop_checkpoint_timer() {
+#if PARKING_THREADS
+    if (!checkpoint_timer_running) return;
+    lock_registry();
+    checkpoint_timer_running = 0;
+    pthread_cond_signal(&checkpoint_wakeup);
+    unlock_registry();
+    pthread_join(checkpoint_thread, NULL);
+#endif
+}
 
-    printf("\nVehicles sorted by total parkings:\n");
-    printf("Vehicle Number | Total Parkings\n");
-    printf("--------------------------------\n");
+// Function to save all changed data to the store files
+void save_data() {
+    printf("Saving data to files...\n");
+    int written = checkpoint();
+    printf("Saved %d changed records to vehicles.dat and parking_spaces.dat\n", written);
 
-    struct vehicle_node* current = sorted_list;
-    while (current != NULL) {
-        printf("%-13s | %d\n", current->vehicle_num, current->parking_count);
-        current = current->next;
+    lock_registry();
+    if (next_vehicle_slot > index_slot_count) {
+        update_plate_index();
     }
+    write_hot_slots();
+    unlock_registry();
+}
 
-    // Free the copied list to avoid memory leaks
-    while (sorted_list != NULL) {
-        struct vehicle_node* temp = sorted_list;
-        sorted_list = sorted_list->next;
-        free(temp);
+// Splits a line into fields without copying, returns the field count (more than max means too many)
+int split_fields(const char* line, int length, struct field fields[], int max_fields) {
+    int count = 0;
+    int i = 0;
+
+    while (i < length) {
+        while (i < length && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) i++;
+        if (i == length) break;
+
+        // Field characters are all above ' ', so one compare covers the common case
+        int start = i;
+        while (i < length && ((unsigned char)line[i] > ' ' ||
+                              (line[i] != ' ' && line[i] != '\t' && line[i] != '\r'))) i++;
+        if (count < max_fields) {
+            fields[count].start = line + start;
+            fields[count].length = i - start;
+        }
+        count++;
     }
+    return count;
 }
 
-void display_sorted_by_amount() {
-    if (vehicle_count == 0) {
-        printf("No vehicles registered.\n");
-        return;
-    }
+// Parses a decimal field into an int, returns 0 on junk or overflow
+int parse_int_field(struct field f, int* value) {
+    int i = 0;
+    int negative = 0;
+    long long result = 0;
 
-    struct vehicle_node* list_copy = copy_list(vehicle_list);
-    struct vehicle_node* sorted_list = mergeSort_by_amount(list_copy);
-    
-    printf("\nVehicles sorted by total amount paid:\n");
-    printf("Vehicle Number | Amount Paid (Rs)\n");
-    printf("--------------------------------\n");
-    
-    struct vehicle_node* current = sorted_list;
-    while (current != NULL) {
-        printf("%-13s | %d\n", current->vehicle_num, current->total_amount_paid);
-        current = current->next;
+    if (f.length > 0 && f.start[0] == '-') {
+        negative = 1;
+        i = 1;
     }
+    if (i == f.length) return 0;
 
-    // Free the copied list
-    while (sorted_list != NULL) {
-        struct vehicle_node* temp = sorted_list;
-        sorted_list = sorted_list->next;
-        free(temp);
+    for (; i < f.length; i++) {
+        if (f.start[i] < '0' || f.start[i] > '9') return 0;
+        result = result * 10 + (f.start[i] - '0');
+        if (result > 2147483647LL) return 0;
     }
+    *value = (int)(negative ? -result : result);
+    return 1;
 }
 
-void display_sorted_by_occupancy() {
-    struct parking_node* list_copy = NULL;
-    struct parking_node* current_orig = parking_list;
-    struct parking_node* tail = NULL;
+// Plates seen so far in vehicles.txt, an open-addressed set kept at most 3/4 full that only lives during the import.
+// Encoded plates are never 0, so 0 marks an empty cell.
+uint64_t* imported_plates = NULL;
+int imported_plate_capacity = 0;
+int imported_plate_count = 0;
 
-    // Create a copy of parking list
-    while (current_orig != NULL) {
-        struct parking_node* new_node = create_parking_node(current_orig->parking_space_ID);
-        new_node->status = current_orig->status;
-        new_node->occupancy_count = current_orig->occupancy_count;
-        new_node->space_revenue = current_orig->space_revenue;
+int remember_imported_plate(uint64_t plate);
 
-        if (list_copy == NULL) {
-            list_copy = tail = new_node;
-        } else {
-            tail->next = new_node;
-            tail = new_node;
-        }
-        current_orig = current_orig->next;
+// Function to size the import set for about expected plates, so a big file is not rehashed as it loads
+void reserve_imported_plates(long expected) {
+    int new_capacity = imported_plate_capacity == 0 ? 4096 : imported_plate_capacity;
+    while (new_capacity < expected + expected / 3 && new_capacity < (1 << 29)) new_capacity *= 2;
+    if (new_capacity == imported_plate_capacity) return;
+
+    int old_capacity = imported_plate_capacity;
+    uint64_t* old_plates = imported_plates;
+    imported_plates = (uint64_t*)calloc(new_capacity, sizeof(uint64_t));
+    if (imported_plates == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
+    }
+    imported_plate_capacity = new_capacity;
+    imported_plate_count = 0;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old_plates[i] != 0) remember_imported_plate(old_plates[i]);
     }
+    free(old_plates);
+}
 
-    struct parking_node* sorted_list = mergeSort_by_occupancy(list_copy);
+// Function to add a plate to the import set, returns 0 if it was already there
+int remember_imported_plate(uint64_t plate) {
+    if ((imported_plate_count + 1) * 4 > imported_plate_capacity * 3) {
+        reserve_imported_plates(imported_plate_count + 1);
+    }
 
-    int total_occupied_spaces = 0;
-    printf("\nParking spaces sorted by occupancy:\n");
-    printf("Space ID | Times Occupied\n");
-    printf("-------------------------\n");
+    int mask = imported_plate_capacity - 1;
+    int cell = (int)((plate * 0x9E3779B97F4A7C15ULL) >> 40) & mask;
+    while (imported_plates[cell] != 0) {
+        if (imported_plates[cell] == plate) return 0;
+        cell = (cell + 1) & mask;
+    }
+    imported_plates[cell] = plate;
+    imported_plate_count++;
+    return 1;
+}
 
-    struct parking_node* current = sorted_list;
-    while (current != NULL) {
-        printf("%-8d | %d\n", current->parking_space_ID, current->occupancy_count);
-        if (current->occupancy_count > 0) {
-            total_occupied_spaces++;
-        }
-        current = current->next;
+// Handles one line of vehicles.txt: 1 if loaded, -1 if blank, 0 with error filled if bad
+int import_vehicle_line(const char* line, int length, char* error, int error_size) {
+    struct field fields[MAX_LINE_FIELDS];
+    int count = split_fields(line, length, fields, MAX_LINE_FIELDS);
+    if (count == 0) return -1;
+    if (count != 7) {
+        snprintf(error, error_size, "expected 7 fields, found %d", count);
+        return 0;
     }
 
-    printf("-------------------------\n");
-    printf("Total Occupied Spaces: %d\n", total_occupied_spaces);
+    uint64_t plate;
+    if (!encode_plate(fields[0].start, fields[0].length, &plate)) {
+        snprintf(error, error_size, "vehicle number must be 1-%d letters or digits", PLATE_MAX_LENGTH);
+        return 0;
+    }
+    if (fields[1].length >= OWNER_NAME_SIZE) {
+        snprintf(error, error_size, "owner name longer than %d characters", OWNER_NAME_SIZE - 1);
+        return 0;
+    }
 
-    // Free the copied list
-    while (sorted_list != NULL) {
-        struct parking_node* temp = sorted_list;
-        sorted_list = sorted_list->next;
-        free(temp);
+    int total_hours, amount_paid, park_count, membership, parking_id;
+    if (!parse_int_field(fields[2], &total_hours) ||
+        !parse_int_field(fields[3], &amount_paid) ||
+        !parse_int_field(fields[4], &park_count) ||
+        !parse_int_field(fields[5], &membership) ||
+        !parse_int_field(fields[6], &parking_id)) {
+        snprintf(error, error_size, "numeric field is not a valid number");
+        return 0;
     }
+    if (membership < NONE || membership > GOLD) {
+        snprintf(error, error_size, "unknown membership %d", membership);
+        return 0;
+    }
+    if (parking_id < 0 || parking_id > 65535) {
+        snprintf(error, error_size, "parking space %d out of range", parking_id);
+        return 0;
+    }
+    // Plates are case-insensitive, so "ka01" repeats an earlier "KA01"
+    if (!remember_imported_plate(plate)) {
+        snprintf(error, error_size, "vehicle number %.*s already registered", fields[0].length, fields[0].start);
+        return 0;
+    }
+
+    struct vehicle_node* new_vehicle = create_vehicle_node();
+    new_vehicle->plate = plate;
+    set_owner_name(new_vehicle, fields[1].start, fields[1].length);
+    new_vehicle->total_parking_hours = total_hours;
+    new_vehicle->total_amount_paid = amount_paid;
+    new_vehicle->parking_count = park_count;
+    new_vehicle->membership = (unsigned char)membership;
+    new_vehicle->parking_ID = (unsigned short)parking_id;
+
+    new_vehicle->next = vehicle_list;
+    vehicle_list = new_vehicle;
+    vehicle_count++;
+    resident_count++;
+    return 1;
 }
 
-void display_sorted_by_revenue() {
-    struct parking_node* list_copy = NULL;
-    struct parking_node* current_orig = parking_list;
-    struct parking_node* tail = NULL;
+// Tail of the parking list while importing, so spaces keep file order
+struct parking_node* import_parking_tail = NULL;
 
-    // Create a copy of parking list
-    while (current_orig != NULL) {
-        struct parking_node* new_node = create_parking_node(current_orig->parking_space_ID);
-        new_node->status = current_orig->status;
-        new_node->occupancy_count = current_orig->occupancy_count;
-        new_node->space_revenue = current_orig->space_revenue;
+// Handles one line of parking_spaces.txt: 1 if loaded, -1 if blank, 0 with error filled if bad
+int import_parking_line(const char* line, int length, char* error, int error_size) {
+    struct field fields[MAX_LINE_FIELDS];
+    int count = split_fields(line, length, fields, MAX_LINE_FIELDS);
+    if (count == 0) return -1;
+    if (count != 4) {
+        snprintf(error, error_size, "expected 4 fields, found %d", count);
+        return 0;
+    }
 
-        if (list_copy == NULL) {
-            list_copy = tail = new_node;
-        } else {
-            tail->next = new_node;
-            tail = new_node;
-        }
-        current_orig = current_orig->next;
+    int id, status, occupancy_count, space_revenue;
+    if (!parse_int_field(fields[0], &id) ||
+        !parse_int_field(fields[1], &status) ||
+        !parse_int_field(fields[2], &occupancy_count) ||
+        !parse_int_field(fields[3], &space_revenue)) {
+        snprintf(error, error_size, "numeric field is not a valid number");
+        return 0;
+    }
+    if (status != FREE && status != OCCUPIED) {
+        snprintf(error, error_size, "unknown status %d", status);
+        return 0;
     }
 
-    struct parking_node* sorted_list = mergeSort_by_revenue(list_copy);
-    
-    int total_revenue = 0;
-    int total_occupancy = 0;
-    
-    printf("\n=== Parking Spaces Sorted by Revenue ===\n");
-    printf("----------------------------------------\n");
-    printf("Space ID | Revenue (Rs) | Times Occupied\n");
-    printf("----------------------------------------\n");
-    
-    struct parking_node* current = sorted_list;
-    while (current != NULL) {
-        printf("   %-5d |    %-8d |      %-8d\n", 
-               current->parking_space_ID,
-               current->space_revenue,
-               current->occupancy_count);
-        total_revenue += current->space_revenue;
-        total_occupancy += current->occupancy_count;
-        current = current->next;
+#if FIXED_LOT
+    struct parking_node* space = space_in_lot(fixed_spaces, id);
+    if (space == NULL) {
+        snprintf(error, error_size, "space %d is outside the fixed lot of %d spaces", id, MAX_PARKING_SPACES);
+        return 0;
     }
-    
-    printf("----------------------------------------\n");
-    printf("Totals   |    %-8d |      %-8d\n", total_revenue, total_occupancy);
-    printf("----------------------------------------\n");
-
-    // Free the copied list
-    while (sorted_list != NULL) {
-        struct parking_node* temp = sorted_list;
-        sorted_list = sorted_list->next;
-        free(temp);
+    set_space_status(fixed_spaces, space, status);
+    space->occupancy_count = occupancy_count;
+    space->space_revenue = space_revenue;
+    return 1;
+#else
+    struct parking_node* new_parking = create_parking_node(id);
+    new_parking->status = status;
+    new_parking->occupancy_count = occupancy_count;
+    new_parking->space_revenue = space_revenue;
+
+    if (parking_list == NULL) {
+        parking_list = new_parking;
+    } else {
+        import_parking_tail->next = new_parking;
     }
+    import_parking_tail = new_parking;
+    return 1;
+#endif
 }
 
-// Function to save all data to file
-void save_data() {
-    printf("Saving data to files...\n");
-    
-    // Save vehicle data
-    FILE *vehicle_file = fopen("vehicles.txt", "w");
-    if (!vehicle_file) {
-        printf("Error: Unable to save vehicle data.\n");
-        return;
+// Streams a text file through a large buffer and hands each line to handle_line.
+// Bad lines are reported with their line number and skipped. Returns the number of loaded lines.
+int import_file(FILE* file, const char* file_name,
+                int (*handle_line)(const char* line, int length, char* error, int error_size)) {
+    char* buffer = (char*)malloc(IMPORT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(1);
     }
 
-    struct vehicle_node* current_vehicle = vehicle_list;
-    int saved_vehicles = 0;
-    while (current_vehicle != NULL) {
-        fprintf(vehicle_file, "%s %s %d %d %d %d %d\n",
-                current_vehicle->vehicle_num,
-                current_vehicle->owner_name,
-                current_vehicle->total_parking_hours,
-                current_vehicle->total_amount_paid,
-                current_vehicle->parking_count,
-                current_vehicle->membership,
-                current_vehicle->parking_ID);
-        current_vehicle = current_vehicle->next;
-        saved_vehicles++;
-    }
-    fclose(vehicle_file);
-    printf("Saved %d vehicles to vehicles.txt\n", saved_vehicles);
+    char error[80];
+    int line_number = 0;
+    int good_lines = 0;
+    int bad_lines = 0;
+    size_t carried = 0;
+    int at_eof = 0;
 
-    // Save parking space data
-    FILE *parking_file = fopen("parking_spaces.txt", "w");
-    if (!parking_file) {
-        printf("Error: Unable to save parking space data.\n");
-        return;
+    while (!at_eof) {
+        size_t read = fread(buffer + carried, 1, IMPORT_BUFFER_SIZE - carried, file);
+        size_t filled = carried + read;
+        if (read == 0) {
+            at_eof = 1;
+            if (filled == 0) break;
+        }
+
+        size_t line_start = 0;
+        char* newline;
+        while ((newline = (char*)memchr(buffer + line_start, '\n', filled - line_start)) != NULL) {
+            size_t i = (size_t)(newline - buffer);
+            line_number++;
+            int result = handle_line(buffer + line_start, (int)(i - line_start), error, sizeof(error));
+            if (result > 0) {
+                good_lines++;
+            } else if (result == 0) {
+                printf("%s:%d: %s, line skipped\n", file_name, line_number, error);
+                bad_lines++;
+            }
+            line_start = i + 1;
+        }
+
+        carried = filled - line_start;
+        if (at_eof && carried > 0) {
+            // Last line without a trailing newline
+            line_number++;
+            int result = handle_line(buffer + line_start, (int)carried, error, sizeof(error));
+            if (result > 0) {
+                good_lines++;
+            } else if (result == 0) {
+                printf("%s:%d: %s, line skipped\n", file_name, line_number, error);
+                bad_lines++;
+            }
+        } else if (carried == IMPORT_BUFFER_SIZE) {
+            printf("%s:%d: line too long, rest of file skipped\n", file_name, line_number + 1);
+            bad_lines++;
+            break;
+        } else {
+            memmove(buffer, buffer + line_start, carried);
+        }
     }
 
-    struct parking_node* current_parking = parking_list;
-    int saved_spaces = 0;
-    while (current_parking != NULL) {
-        fprintf(parking_file, "%d %d %d %d\n",
-                current_parking->parking_space_ID,
-                current_parking->status,
-                current_parking->occupancy_count,
-                current_parking->space_revenue);
-        current_parking = current_parking->next;
-        saved_spaces++;
+    free(buffer);
+    if (bad_lines > 0) {
+        printf("%d bad line(s) skipped in %s\n", bad_lines, file_name);
     }
-    fclose(parking_file);
-    printf("Saved %d parking spaces to parking_spaces.txt\n", saved_spaces);
+    return good_lines;
 }
 
 // Function to load data from file
+// The binary stores are used when present; otherwise the text files are imported
+// and everything is marked changed so the first save creates the stores.
+// Spaces are loaded first so vehicles parked in them stay in memory.
 void load_data() {
     printf("Loading data from files...\n");
+    load_membership_tiers();
     
-    // Load vehicle data
-    FILE *vehicle_file = fopen("vehicles.txt", "r");
-    if (!vehicle_file) {
-        printf("No previous vehicle data found. Starting fresh.\n");
+    // Load parking space data or initialize if no file exists.
+    // The fixed lot always has its full layout; saved spaces are filled into it.
+#if FIXED_LOT
+    initialize_parking_spaces();
+#endif
+    long stored_spaces = open_store("parking_spaces.dat", "PKS1", sizeof(struct parking_record), &parking_store);
+    if (stored_spaces > 0) {
+        if (!load_parking_store(stored_spaces)) {
+#if FIXED_LOT
+            // Start the store again so it holds exactly the fixed layout, in order
+            fclose(parking_store);
+            remove("parking_spaces.dat");
+            open_store("parking_spaces.dat", "PKS1", sizeof(struct parking_record), &parking_store);
+#endif
+            for (struct parking_node* current = parking_list; current != NULL; current = current->next) {
+                current->dirty = 1;
+            }
+#if FIXED_LOT
+            write_dirty_spaces();
+#endif
+        }
+        printf("Loaded %ld parking spaces from parking_spaces.dat\n", stored_spaces);
     } else {
-        char vehicle_num[10], owner_name[20];
-        int total_hours, amount_paid, park_count, membership, parking_id;
-
-        while (fscanf(vehicle_file, "%s %s %d %d %d %d %d",
-                      vehicle_num,
-                      owner_name,
-                      &total_hours,
-                      &amount_paid,
-                      &park_count,
-                      &membership,
-                      &parking_id) == 7) {
-            struct vehicle_node* new_vehicle = create_vehicle_node();
-            strcpy(new_vehicle->vehicle_num, vehicle_num);
-            strcpy(new_vehicle->owner_name, owner_name);
-            new_vehicle->total_parking_hours = total_hours;
-            new_vehicle->total_amount_paid = amount_paid;
-            new_vehicle->parking_count = park_count;
-            new_vehicle->membership = membership;
-            new_vehicle->parking_ID = parking_id;
-
-            new_vehicle->next = vehicle_list;
-            vehicle_list = new_vehicle;
-            vehicle_count++;
-        }
-        fclose(vehicle_file);
-        printf("Loaded %d vehicles from vehicles.txt\n", vehicle_count);
-    }
-
-    // Load parking space data or initialize if no file exists
-    FILE *parking_file = fopen("parking_spaces.txt", "r");
-    if (!parking_file) {
-        printf("No previous parking space data found. Initializing fresh parking spaces.\n");
-        initialize_parking_spaces();
+        FILE *parking_file = fopen("parking_spaces.txt", "rb");
+        if (!parking_file) {
+            printf("No previous parking space data found. Initializing fresh parking spaces.\n");
+            initialize_parking_spaces();
+        } else {
+            printf("Loading parking space data from parking_spaces.txt\n");
+            import_parking_tail = NULL;
+            int loaded_spaces = import_file(parking_file, "parking_spaces.txt", import_parking_line);
+            fclose(parking_file);
+            printf("Loaded %d parking spaces from parking_spaces.txt\n", loaded_spaces);
+        }
+        for (struct parking_node* current = parking_list; current != NULL; current = current->next) {
+            current->dirty = 1;
+        }
+    }
+
+    // Load vehicle data
+    long stored_vehicles = open_store("vehicles.dat", "PKV1", sizeof(struct vehicle_record), &vehicle_store);
+    if (stored_vehicles > 0) {
+        load_vehicle_store(stored_vehicles);
+        printf("Loaded %d vehicles from vehicles.dat, %d kept in memory\n", vehicle_count, resident_count);
     } else {
-        printf("Loading parking space data from parking_spaces.txt\n");
-        struct parking_node* current = NULL;
-        int id, status, occupancy_count, space_revenue;
-        int loaded_spaces = 0;
-
-        while (fscanf(parking_file, "%d %d %d %d",
-                      &id,
-                      &status,
-                      &occupancy_count,
-                      &space_revenue) == 4) {
-            struct parking_node* new_parking = create_parking_node(id);
-            new_parking->status = status;
-            new_parking->occupancy_count = occupancy_count;
-            new_parking->space_revenue = space_revenue;
-
-            if (parking_list == NULL) {
-                parking_list = new_parking;
-                current = new_parking;
-            } else {
-                current->next = new_parking;
-                current = new_parking;
+        FILE *vehicle_file = fopen("vehicles.txt", "rb");
+        if (!vehicle_file) {
+            printf("No previous vehicle data found. Starting fresh.\n");
+        } else {
+            // A vehicles.txt line is usually 30-40 bytes
+            fseek(vehicle_file, 0, SEEK_END);
+            reserve_imported_plates(ftell(vehicle_file) / 32);
+            rewind(vehicle_file);
+            import_file(vehicle_file, "vehicles.txt", import_vehicle_line);
+            fclose(vehicle_file);
+            free(imported_plates);
+            imported_plates = NULL;
+            imported_plate_capacity = 0;
+            imported_plate_count = 0;
+            for (struct vehicle_node* current = vehicle_list; current != NULL; current = current->next) {
+                mark_vehicle_dirty(current);
             }
-            loaded_spaces++;
+            printf("Loaded %d vehicles from vehicles.txt\n", vehicle_count);
         }
-        fclose(parking_file);
-        printf("Loaded %d parking spaces from parking_spaces.txt\n", loaded_spaces);
+        build_plate_index(NULL, 0);
     }
     printf("Data loading completed successfully.\n");
 }
 
 // Function to free all allocated memory
 void cleanup() {
-    struct vehicle_node* current_vehicle = vehicle_list;
-    while (current_vehicle != NULL) {
-        struct vehicle_node* temp_vehicle = current_vehicle;
-        current_vehicle = current_vehicle->next;
-        free(temp_vehicle);
+    while (vehicle_blocks != NULL) {
+        struct vehicle_block* temp_block = vehicle_blocks;
+        vehicle_blocks = vehicle_blocks->next;
+        free(temp_block);
     }
+    vehicle_list = NULL;
+    spare_vehicles = NULL;
 
+#if !FIXED_LOT
     struct parking_node* current_parking = parking_list;
     while (current_parking != NULL) {
         struct parking_node* temp_parking = current_parking;
         current_parking = current_parking->next;
         free(temp_parking);
     }
+#endif
+
+    while (name_blocks != NULL) {
+        struct name_block* temp_name_block = name_blocks;
+        name_blocks = name_blocks->next;
+        free(temp_name_block);
+    }
+    free(name_table);
+
+    while (trie_blocks != NULL) {
+        struct trie_block* temp_block = trie_blocks;
+        trie_blocks = trie_blocks->next;
+        free(temp_block);
+    }
+    plate_trie = NULL;
+    spare_trie_nodes = NULL;
+
+    if (current_snapshot != NULL) {
+        release_snapshot(current_snapshot);
+        current_snapshot = NULL;
+    }
+
+#if FIXED_LOT
+    if (dirty_vehicles != fixed_dirty_queue) free(dirty_vehicles);
+#else
+    free(dirty_vehicles);
+#endif
+    free(resident_slots);
+    free(index_fences);
+    if (plate_index) fclose(plate_index);
+    if (vehicle_store) fclose(vehicle_store);
+    if (parking_store) fclose(parking_store);
 }
 
-struct vehicle_node* copy_list(struct vehicle_node* head) {
-    if (head == NULL) return NULL;
+#if PARKING_BENCH
+double nanoseconds_per_round(clock_t start) {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / BENCH_ROUNDS;
+}
 
-    struct vehicle_node* new_head = NULL;
-    struct vehicle_node* tail = NULL;
+// Times the gate path on the compiled lot without touching any data file.
+// The lot is filled except for the last space of every tier, so each search
+// has to pass the whole tier. Fees are first checked against the formula,
+// which a copy of gate_policy always uses. Park + exit goes through the same
+// lock, plate lookup and save queue as the gate menu.
+int run_gate_benchmark() {
+    struct lot_policy formula_policy = gate_policy;
+    for (int membership = NONE; membership <= GOLD; membership++) {
+        for (int hours = -2; hours < 2 * FIXED_FEE_HOURS; hours++) {
+            if (calculate_parking_fee(hours, membership, &gate_policy) !=
+                calculate_parking_fee(hours, membership, &formula_policy)) {
+                printf("Fee for %d hours (membership %d) does not match the tariff.\n", hours, membership);
+                return 1;
+            }
+        }
+    }
 
-    while (head != NULL) {
-        struct vehicle_node* new_node = create_vehicle_node();
-        strcpy(new_node->vehicle_num, head->vehicle_num);
-        strcpy(new_node->owner_name, head->owner_name);
-        new_node->arrival = head->arrival;
-        new_node->departure = head->departure;
-        new_node->membership = head->membership;
-        new_node->total_parking_hours = head->total_parking_hours;
-        new_node->parking_ID = head->parking_ID;
-        new_node->total_amount_paid = head->total_amount_paid;
-        new_node->parking_count = head->parking_count;
-
-        if (new_head == NULL) {
-            new_head = new_node;
-            tail = new_node;
-        } else {
-            tail->next = new_node;
-            tail = new_node;
+    initialize_parking_spaces();
+    struct vehicle_node parked[MAX_PARKING_SPACES];
+    memset(parked, 0, sizeof(parked));
+    int parked_count = 0;
+    for (int membership = NONE; membership <= GOLD; membership++) {
+        while (parked_count < MAX_PARKING_SPACES) {
+            parked[parked_count].membership = membership;
+            if (admit_vehicle(parking_list, &gate_policy, &parked[parked_count], 0) == NULL) break;
+            parked_count++;
+        }
+    }
+    int last_spaces[3] = { MAX_PARKING_SPACES, PREMIUM_LAST_SPACE, GOLD_LAST_SPACE };
+    for (int i = 0; i < parked_count; i++) {
+        int space_ID = parked[i].parking_ID;
+        if (space_ID == last_spaces[NONE] || space_ID == last_spaces[PREMIUM] || space_ID == last_spaces[GOLD]) {
+            int hours;
+            release_vehicle(parking_list, &gate_policy, &parked[i], 0, &hours);
         }
+    }
 
-        head = head->next;
+    // Three registered vehicles, one per tier, go through park_plate() and exit_plate() the way
+    // the gate menu does. Registering them counts as gate path too, so the heap is watched from here.
+    void* heap_before[4] = { vehicle_blocks, trie_blocks, name_blocks, dirty_vehicles };
+    const char* bench_plates[3] = { "BENCH1", "BENCH2", "BENCH3" };
+    struct vehicle_node* vehicles[3];
+    for (int tier = NONE; tier <= GOLD; tier++) {
+        uint64_t plate;
+        int fee, hours;
+        encode_plate(bench_plates[tier], (int)strlen(bench_plates[tier]), &plate);
+        lock_registry();
+        park_plate(plate, "Bench", 0);
+        vehicles[tier] = exit_plate(plate, 0, &fee, &hours);
+        unlock_registry();
     }
+    volatile long checksum = 0;
 
-    return new_head;
+    clock_t start = clock();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        struct parking_node* space = find_space_in_lot(parking_list, i % 3, &gate_policy);
+        checksum += space != NULL ? space->parking_space_ID : 0;
+    }
+    double find_time = nanoseconds_per_round(start);
+
+    start = clock();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        checksum += calculate_parking_fee(i % 48, i % 3, &gate_policy);
+    }
+    double fee_time = nanoseconds_per_round(start);
+
+    start = clock();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        int fee, hours;
+        struct vehicle_node* vehicle = vehicles[i % 3];
+        lock_registry();
+        // Reset the totals so no round earns an upgrade or overflows them
+        vehicle->membership = i % 3;
+        vehicle->total_parking_hours = 0;
+        vehicle->total_amount_paid = 0;
+        struct parking_node* space = park_plate(vehicle->plate, "", 0);
+        exit_plate(vehicle->plate, (uint32_t)(i % 48) * 60, &fee, &hours);
+        space->space_revenue = 0;
+        unlock_registry();
+        checksum += fee;
+    }
+    double gate_time = nanoseconds_per_round(start);
+    void* heap_after[4] = { vehicle_blocks, trie_blocks, name_blocks, dirty_vehicles };
+
+    printf("%s build, %d rounds each\n", FIXED_LOT ? "FIXED_LOT" : "Generic", BENCH_ROUNDS);
+    printf("Find a space: %.1f ns\n", find_time);
+    printf("Fee:          %.1f ns\n", fee_time);
+    printf("Park + exit:  %.1f ns\n", gate_time);
+    printf("Registry heap allocation on the gate path: %s\n",
+           memcmp(heap_before, heap_after, sizeof(heap_before)) != 0 ? "yes" : "none");
+    printf("(checksum %ld)\n", (long)checksum);
+    return 0;
 }
+#endif
 
 // Main function
 int main() {
+#if PARKING_BENCH
+    return run_gate_benchmark();
+#endif
     printf("Initializing Smart Parking System...\n");
     
     // First load data (this will initialize parking spaces if no file exists)
     load_data();
     
     int choice;
+    time_t last_checkpoint = time(NULL);
+    int timed_checkpoints = start_checkpoint_timer();
     printf("\nWelcome to Smart Parking System\n");
 
     do {
@@ -867,6 +4316,11 @@ int main() {
         printf("4. Display Vehicles by Total Amount Paid\n");
         printf("5. Display Parking Spaces by Occupancy\n");
         printf("6. Display Parking Spaces by Revenue\n");
+        printf("7. Re-evaluate Memberships\n");
+        printf("8. Export Report\n");
+        printf("9. Search Vehicle Numbers\n");
+        printf("10. Run Simulation\n");
+        printf("11. Export Data as Text\n");
         printf("0. Exit System\n");
         printf("===============================\n");    
         printf("Enter your choice: ");
@@ -896,7 +4350,24 @@ int main() {
             case 6:
                 display_sorted_by_revenue();
                 break;
+            case 7:
+                retier_vehicles();
+                break;
+            case 8:
+                export_report();
+                break;
+            case 9:
+                search_plates();
+                break;
+            case 10:
+                run_simulation();
+                break;
+            case 11:
+                export_text_data();
+                break;
             case 0:
+                stop_checkpoint_timer();
+                wait_for_exports();
                 save_data();
                 printf("\nCleaning up and saving data...\n");
                 cleanup();
@@ -905,6 +4376,12 @@ int main() {
             default:
                 printf("\nInvalid choice. Please try again.\n");
         }
+
+        // Without the timer thread, write changed records after menu actions every few seconds
+        if (!timed_checkpoints && choice != 0 && time(NULL) - last_checkpoint >= CHECKPOINT_SECONDS) {
+            checkpoint();
+            last_checkpoint = time(NULL);
+        }
     } while (choice != 0);
 
     return 0;